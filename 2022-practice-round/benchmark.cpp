@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include "conflict_graph.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include "dynamic_bitset.h"
+#include <fstream>
+#include "heuristics.h"
+#include "incremental_fitness.h"
+#include "input.h"
+#include <iostream>
+#include <memory>
+#include "options.h"
+#include <random>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// Usage: benchmark [--inputs DIR] [--bin DIR] [--time-limit SECS] [--seed N]
+//                  [--format csv|json] [--cases micro,heuristics,solvers]
+//                  [--solvers a,b,...] [--only-inputs a,b,...] [--keep-work-dir]
+// Micro-benchmarks and heuristics run in-process. Solvers are run from --bin
+// with a fixed seed and time limit; their checkpoints are scored as they are
+// written to give an anytime curve. The solvers' working directory is removed
+// afterwards unless a solver failed or --keep-work-dir is given.
+
+typedef chrono::steady_clock Clock;
+
+const vector<string> input_names = {"a_an_example", "b_basic", "c_coarse", "d_difficult", "e_elaborate"};
+const vector<string> default_solvers = {"hill_climbing", "hill_climbing_no_pool", "metropolis", "genetic", "pizza_bnb", "best_first_search", "pizza_ils"};
+
+typedef struct Record {
+	string benchmark;
+	string input;
+	string metric;
+	double time;
+	double value;
+} Record;
+
+vector<Record> records;
+
+void record(const string& benchmark, const string& input, const string& metric, double value, double time = -1) {
+	records.push_back(Record{benchmark, input, metric, time, value});
+	cerr << benchmark << " " << input << " " << metric << (time >= 0 ? " @" + to_string(time) + "s" : "") << ": " << value << endl;
+}
+
+double seconds_since(Clock::time_point start) {
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Average seconds per call, repeating until min_seconds have passed.
+template <class F>
+double time_per_call(F f, double min_seconds = 0.2) {
+	const Clock::time_point start = Clock::now();
+	size_t calls = 0;
+	do {
+		f();
+		++calls;
+	} while (seconds_since(start) < min_seconds);
+	return seconds_since(start) / calls;
+}
+
+vector<string> split(const string& text) {
+	vector<string> parts;
+	stringstream stream(text);
+	string part;
+	while (getline(stream, part, ',')) {
+		if (!part.empty()) parts.push_back(part);
+	}
+	return parts;
+}
+
+string read_file(const string& path) {
+	ifstream file(path, ios::binary);
+	stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+size_t score_ingredients(const Preferences& preferences, const vector<char>& ingredients) {
+	size_t satisfied = 0;
+	for (size_t client = 0; client < preferences.num_clients(); ++client) {
+		if (preferences.satisfied(client, ingredients)) ++satisfied;
+	}
+	return satisfied;
+}
+
+size_t score_clients(const Preferences& preferences, const unordered_set<int>& clients) {
+	return score_ingredients(preferences, preferences.liked_ingredients(clients));
+}
+
+size_t score_solution(const Instance& instance, const string& path) {
+	vector<char> ingredients(instance.num_ingredients(), 0);
+	for (int ingredient : load_solution(instance, path)) ingredients[ingredient] = 1;
+	return score_ingredients(instance.preferences, ingredients);
+}
+
+void micro_benchmarks(const string& name, const string& path, const string& text, const Instance& instance, mt19937_64& generator) {
+	record("parse", name, "seconds", time_per_call([&] { parse_instance(text); }));
+	record("conflict_graph", name, "seconds", time_per_call([&] { build_conflict_graph(instance.preferences); }));
+
+	const shared_ptr<const InputBuffer> cache = make_shared<const InputBuffer>(encode_cache(instance, path));
+	record("cache_load", name, "seconds", time_per_call([&] { read_instance(cache); }));
+
+	const Preferences& preferences = instance.preferences;
+	const size_t num_ingredients = instance.num_ingredients();
+	vector<DynamicBitSet> likes, dislikes;
+	for (size_t client = 0; client < preferences.num_clients(); ++client) {
+		likes.emplace_back(num_ingredients);
+		dislikes.emplace_back(num_ingredients);
+		for (int ingredient : preferences.likes(client)) likes.back().set(ingredient);
+		for (int ingredient : preferences.dislikes(client)) dislikes.back().set(ingredient);
+	}
+	DynamicBitSet ingredients(num_ingredients);
+	for (size_t i = 0; i < num_ingredients; ++i) ingredients.set(i, generator() & 1);
+	volatile size_t sink = 0;
+	const double evaluate_seconds = time_per_call([&] {
+		size_t satisfied = 0;
+		for (size_t client = 0; client < likes.size(); ++client) {
+			if (likes[client].is_subset_of(ingredients) && !dislikes[client].intersects(ingredients)) ++satisfied;
+		}
+		sink = satisfied;
+	});
+	record("evaluate_fitness", name, "evaluations_per_second", 1 / evaluate_seconds);
+
+	IncrementalFitness fitness(preferences);
+	fitness.reset(ingredients);
+	uniform_int_distribution<int> ingredient_dist(0, num_ingredients - 1);
+	const double flip_seconds = time_per_call([&] {
+		fitness.flip(ingredient_dist(generator));
+		fitness.rollback();
+	});
+	record("incremental_flip", name, "evaluations_per_second", 1 / flip_seconds);
+}
+
+void heuristic_benchmarks(const string& name, const Instance& instance) {
+	const ConflictGraph& graph = instance.conflict_graph();
+	const Preferences& preferences = instance.preferences;
+	vector<IdRange> likes, dislikes;
+	for (size_t client = 0; client < preferences.num_clients(); ++client) {
+		likes.push_back(preferences.likes(client));
+		dislikes.push_back(preferences.dislikes(client));
+	}
+	auto run = [&](const string& heuristic, auto solve) {
+		unordered_set<int> clients;
+		const double seconds = time_per_call([&] { clients = solve(); }, 0);
+		record(heuristic, name, "seconds", seconds);
+		record(heuristic, name, "score", score_clients(preferences, clients));
+	};
+	run("removeMostConflictingBucketed", [&] { return removeMostConflictingBucketed(graph); });
+	run("addLeastConflictingBucketed", [&] { return addLeastConflictingBucketed(graph); });
+	run("randomResolution", [&] { return randomResolution(graph); });
+	run("uniformRandomResolution", [&] { return uniformRandomResolution(graph); });
+	run("leastDislikes", [&] { return leastDislikes(graph, dislikes); });
+	run("fewestPreferences", [&] { return fewestPreferences(graph, likes, dislikes); });
+}
+
+long long modification_time(const string& path) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return 0;
+	return info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+}
+
+// Returns whether the solver exited cleanly.
+bool solver_benchmark(const string& solver, const string& binary, const string& name, const string& input, const Instance& instance, double time_limit, long long seed, const string& work_dir) {
+	const string checkpoint = work_dir + "/" + solver + "." + name + ".checkpoint";
+	const string output = work_dir + "/" + solver + "." + name + ".out";
+	const string log = work_dir + "/" + solver + "." + name + ".log";
+	remove(checkpoint.c_str());
+	vector<string> arguments = {binary, input, "--time-limit", to_string(time_limit), "--seed", to_string(seed), "--checkpoint", checkpoint, "--checkpoint-interval", "0.25"};
+
+	const Clock::time_point start = Clock::now();
+	const pid_t pid = fork();
+	if (pid == 0) {
+		freopen(output.c_str(), "w", stdout);
+		freopen(log.c_str(), "w", stderr);
+		vector<char*> argv;
+		for (string& argument : arguments) argv.push_back(&argument[0]);
+		argv.push_back(nullptr);
+		execv(binary.c_str(), argv.data());
+		_exit(127);
+	}
+
+	int status = 0;
+	struct rusage usage;
+	long long last_checkpoint = 0;
+	size_t best_score = 0;
+	while (wait4(pid, &status, WNOHANG, &usage) == 0) {
+		usleep(100000);
+		const long long modified = modification_time(checkpoint);
+		if (modified != last_checkpoint) {
+			last_checkpoint = modified;
+			const size_t score = score_solution(instance, checkpoint);
+			if (score > best_score || best_score == 0) record(solver, name, "score", score, seconds_since(start));
+			best_score = max(best_score, score);
+		}
+		if (seconds_since(start) > time_limit + 30) kill(pid, SIGKILL);
+	}
+	const double wall = seconds_since(start);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		cerr << solver << " on " << name << " failed; see " << log << endl;
+		record(solver, name, "failed", 1);
+		return false;
+	}
+	const size_t score = score_solution(instance, output);
+	record(solver, name, "score", score, wall);
+	record(solver, name, "final_score", score);
+	record(solver, name, "wall_seconds", wall);
+	record(solver, name, "peak_rss_kb", usage.ru_maxrss);
+
+	const string stderr_text = read_file(log);
+	const size_t position = stderr_text.rfind("Iterations: ");
+	if (position != string::npos) {
+		const double iterations = atof(stderr_text.c_str() + position + 12);
+		const size_t elapsed_at = stderr_text.find("Elapsed: ", position);
+		const double elapsed = elapsed_at == string::npos ? wall : atof(stderr_text.c_str() + elapsed_at + 9);
+		record(solver, name, "iterations", iterations);
+		if (elapsed > 0) record(solver, name, "iterations_per_second", iterations / elapsed);
+	}
+	return true;
+}
+
+void remove_directory(const string& path) {
+	DIR* directory = opendir(path.c_str());
+	if (directory == nullptr) return;
+	while (const dirent* entry = readdir(directory)) {
+		const string entry_name = entry->d_name;
+		if (entry_name != "." && entry_name != "..") unlink((path + "/" + entry_name).c_str());
+	}
+	closedir(directory);
+	rmdir(path.c_str());
+}
+
+string json_escape(const string& text) {
+	string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+void write_records(const string& format) {
+	if (format == "json") {
+		cout << "[" << endl;
+		for (size_t i = 0; i < records.size(); ++i) {
+			const Record& r = records[i];
+			cout << "  {\"benchmark\": \"" << json_escape(r.benchmark) << "\", \"input\": \"" << json_escape(r.input) << "\", \"metric\": \"" << r.metric << "\"";
+			if (r.time >= 0) cout << ", \"time\": " << r.time;
+			cout << ", \"value\": " << r.value << "}" << (i + 1 < records.size() ? "," : "") << endl;
+		}
+		cout << "]" << endl;
+		return;
+	}
+	cout << "benchmark,input,metric,time,value" << endl;
+	for (const Record& r : records) {
+		cout << r.benchmark << "," << r.input << "," << r.metric << ",";
+		if (r.time >= 0) cout << r.time;
+		cout << "," << r.value << endl;
+	}
+}
+
+int main(int argc, char** argv) {
+
+	const Options options(argc, argv);
+	const string inputs_dir = options.get("inputs", ".");
+	const string bin_dir = options.get("bin", ".");
+	const double time_limit = options.get_double("time-limit", 5);
+	const long long seed = options.get_int("seed", 1);
+	const string format = options.get("format", "csv");
+	const vector<string> cases = split(options.get("cases", "micro,heuristics,solvers"));
+	const vector<string> solvers = options.has("solvers") ? split(options.get("solvers")) : default_solvers;
+	const vector<string> names = options.has("only-inputs") ? split(options.get("only-inputs")) : input_names;
+	auto enabled = [&](const string& name) { return find(cases.begin(), cases.end(), name) != cases.end(); };
+
+	char work_template[] = "/tmp/pizza-benchmark-XXXXXX";
+	if (mkdtemp(work_template) == nullptr) {
+		cerr << "Could not create a working directory from " << work_template << ": " << strerror(errno) << endl;
+		return 1;
+	}
+	const string work_dir = work_template;
+	bool keep_work_dir = options.has("keep-work-dir");
+	cerr << "Writing solver outputs to " << work_dir << endl;
+
+	mt19937_64 generator(seed);
+
+	for (const string& name : names) {
+		const string path = inputs_dir + "/" + name + ".in.txt";
+		const string text = read_file(path);
+		if (text.empty()) {
+			cerr << "Could not read " << path << endl;
+			continue;
+		}
+
+		Clock::time_point start = Clock::now();
+		const Instance instance = parse_instance(text);
+		record("load", name, "parse_seconds", seconds_since(start));
+		start = Clock::now();
+		instance.conflict_graph();
+		record("load", name, "graph_seconds", seconds_since(start));
+		record("load", name, "clients", instance.num_clients());
+		record("load", name, "ingredients", instance.num_ingredients());
+		record("load", name, "conflicts", instance.conflict_graph().num_edges());
+
+		if (enabled("micro")) micro_benchmarks(name, path, text, instance, generator);
+		if (enabled("heuristics")) heuristic_benchmarks(name, instance);
+		if (enabled("solvers")) {
+			for (const string& solver : solvers) {
+				if (!solver_benchmark(solver, bin_dir + "/" + solver, name, path, instance, time_limit, seed, work_dir)) keep_work_dir = true;
+			}
+		}
+	}
+
+	write_records(format);
+	if (keep_work_dir) cerr << "Kept solver outputs in " << work_dir << endl;
+	else remove_directory(work_dir);
+
+	return 0;
+}
@@ -1,13 +1,17 @@
+#include <algorithm>
+#include "conflict_graph.h"
+#include "input.h"
 #include <iostream>
-#include <queue>
+#include "options.h"
+#include "run_control.h"
+#include <set>
 #include <signal.h>
+#include "telemetry.h"
 #include <unordered_set>
 #include <vector>
 
 using namespace std;
 
-bool running = true;
-
 void sigint_handler(int sig) {
 	cerr << "Stopping search..." << endl;
 	running = false;
@@ -18,69 +22,169 @@ typedef struct Context {
 	int estimated_value;
 	vector<int> included;
 	unordered_set<int> potential;
-	Context(int person, int estimated_value, vector<int> included, unordered_set<int> potential) : person(person), estimated_value(estimated_value), included(included), potential(potential) {}
+	Context(int person, int estimated_value, vector<int> included, unordered_set<int> potential) : person(person), estimated_value(estimated_value), included(std::move(included)), potential(std::move(potential)) {}
 	friend constexpr bool operator<(const Context& l, const Context& r) {
 		return l.estimated_value < r.estimated_value;
 	} 
 } Context;
 
-int heuristic(const vector<unordered_set<int>>& graph, unordered_set<int> potential) {
-	int numSatisfied = 0;
-	while (potential.size() > 0) {
-		int leastConflicts = graph.size() + 1;
-		int leastConflictingPerson = -1;
+size_t approximate_bytes(const Context& context) {
+	constexpr size_t tree_node_overhead = 4 * sizeof(void*);
+	constexpr size_t hash_node_size = sizeof(void*) + sizeof(size_t) + sizeof(int);
+	return sizeof(Context) + tree_node_overhead
+		+ context.included.capacity() * sizeof(int)
+		+ context.potential.bucket_count() * sizeof(void*)
+		+ context.potential.size() * hash_node_size;
+}
+
+size_t parse_bytes(const string& text) {
+	size_t end = 0;
+	const double value = stod(text, &end);
+	const string suffix = text.substr(end);
+	double multiplier = 1;
+	if (suffix == "K" || suffix == "k") multiplier = 1024.0;
+	else if (suffix == "M" || suffix == "m") multiplier = 1024.0 * 1024.0;
+	else if (suffix == "G" || suffix == "g") multiplier = 1024.0 * 1024.0 * 1024.0;
+	return value * multiplier;
+}
+
+// Frontier ordered by estimated value. With a byte budget the worst nodes are
+// evicted once the estimate goes over it, and the largest bound among them is
+// kept so we know whether the answer is still provably optimal.
+typedef struct Frontier {
+	multiset<Context> nodes;
+	size_t budget;
+	size_t bytes;
+	size_t peak_nodes;
+	size_t peak_bytes;
+	size_t evicted;
+	size_t evicted_bound;
+
+	Frontier(size_t budget) : budget(budget), bytes(0), peak_nodes(0), peak_bytes(0), evicted(0), evicted_bound(0) {}
+
+	size_t size() const { return nodes.size(); }
+
+	void push(Context context) {
+		bytes += approximate_bytes(context);
+		nodes.insert(std::move(context));
+		while (budget > 0 && bytes > budget && nodes.size() > 1) {
+			auto worst = nodes.extract(nodes.begin());
+			bytes -= approximate_bytes(worst.value());
+			evicted_bound = max(evicted_bound, worst.value().included.size() + worst.value().potential.size());
+			++evicted;
+		}
+		peak_nodes = max(peak_nodes, nodes.size());
+		peak_bytes = max(peak_bytes, bytes);
+	}
+
+	Context pop() {
+		auto best = nodes.extract(prev(nodes.end()));
+		bytes -= approximate_bytes(best.value());
+		return std::move(best.value());
+	}
+} Frontier;
+
+// Greedy min-degree independent set over the potential clients, used as the
+// node estimate. Residual degrees live in bucket lists so each step takes the
+// lowest non-empty bucket, and every edge is touched a constant number of
+// times. The arrays are reused between calls.
+typedef struct MinDegreeHeuristic {
+	const ConflictGraph& graph;
+	vector<size_t> live;
+	size_t stamp;
+	vector<int> residual;
+	vector<int> next;
+	vector<int> previous;
+	vector<int> head;
+
+	MinDegreeHeuristic(const ConflictGraph& graph) : graph(graph), live(graph.size(), 0), stamp(0), residual(graph.size()), next(graph.size()), previous(graph.size()), head(graph.size() + 1, -1) {}
+
+	void unlink(int person) {
+		if (previous[person] >= 0) next[previous[person]] = next[person];
+		else head[residual[person]] = next[person];
+		if (next[person] >= 0) previous[next[person]] = previous[person];
+	}
+
+	void link(int person) {
+		previous[person] = -1;
+		next[person] = head[residual[person]];
+		if (next[person] >= 0) previous[next[person]] = person;
+		head[residual[person]] = person;
+	}
+
+	int operator()(const unordered_set<int>& potential) {
+		++stamp;
+		for (int person : potential) live[person] = stamp;
+		int lowest = graph.size();
 		for (int person : potential) {
-			int conflicts = 0;
-			if (potential.size() < graph[person].size()) {
-				for (int potential_neighbour : potential) {
-					conflicts += graph[person].count(potential_neighbour);
-				}
-			}
-			else {
-				for (int neighbour : graph[person]){
-					conflicts += potential.count(neighbour);
+			residual[person] = 0;
+			for (int neighbour : graph[person]) residual[person] += live[neighbour] == stamp;
+			link(person);
+			lowest = min(lowest, residual[person]);
+		}
+
+		int numSatisfied = 0;
+		size_t remaining = potential.size();
+		while (remaining > 0) {
+			while (head[lowest] < 0) ++lowest;
+			const int chosen = head[lowest];
+			numSatisfied++;
+			auto remove = [&](int person) {
+				unlink(person);
+				live[person] = 0;
+				--remaining;
+				for (int neighbour : graph[person]) {
+					if (live[neighbour] != stamp) continue;
+					unlink(neighbour);
+					--residual[neighbour];
+					link(neighbour);
+					lowest = min(lowest, residual[neighbour]);
 				}
-			}
-			if (conflicts < leastConflicts) {
-				leastConflicts = conflicts;
-				leastConflictingPerson = person;
+			};
+			remove(chosen);
+			for (int neighbour : graph[chosen]) {
+				if (live[neighbour] == stamp) remove(neighbour);
 			}
 		}
-		numSatisfied++;
-		for (int neighbour : graph[leastConflictingPerson]) potential.erase(neighbour);
-		potential.erase(leastConflictingPerson);
+		return numSatisfied;
 	}
-	return numSatisfied;
-}
+} MinDegreeHeuristic;
 
-vector<int> best_first_search(const vector<unordered_set<int>>& graph) {
+vector<int> best_first_search(const Instance& instance, Frontier& to_visit, RunControl& control) {
+	const ConflictGraph& graph = instance.conflict_graph();
 	vector<int> best_so_far;
+	MinDegreeHeuristic heuristic(graph);
 
-	priority_queue<Context> to_visit;
 	unordered_set<int> potential;
-	for (int i = 0; i < graph.size(); ++i) potential.insert(i);
+	for (int i = 0; i < (int)graph.size(); ++i) potential.insert(i);
 	to_visit.push(Context(0, 0, vector<int>(), potential));
 
 	while (running && to_visit.size() > 0) {
-		Context frame = to_visit.top();
-		to_visit.pop();
+		if (control.checkpoint_due()) control.checkpoint(solution_text(instance.ingredient_names(), instance.preferences.liked_ingredients(best_so_far)));
+		control.tick();
+		telemetry.add(nodes_expanded);
+		Context frame = to_visit.pop();
 
 		const int bound = frame.included.size() + frame.potential.size() + 1;
-		if (bound <= best_so_far.size()) continue;
+		if (bound <= (int)best_so_far.size()) {
+			telemetry.add(nodes_pruned);
+			continue;
+		}
 
 		if (frame.included.size() > best_so_far.size()) {
 			best_so_far = frame.included;
-			cerr << "Best so far: " << best_so_far.size() << endl;
+			telemetry.add(bound_hits);
+			telemetry.improve(best_so_far.size());
 		}
 
-		if (frame.person == graph.size()) continue;
+		if (frame.person == (int)graph.size()) continue;
 		 
 		const bool has_current_person = frame.potential.count(frame.person) != 0;
 		frame.potential.erase(frame.person);
 
 		const int left_bound = frame.included.size() + frame.potential.size(); 
-		if (left_bound > best_so_far.size()) {
-			to_visit.push(Context(frame.person + 1, frame.included.size() + heuristic(graph, frame.potential), frame.included, frame.potential));
+		if (left_bound > (int)best_so_far.size()) {
+			to_visit.push(Context(frame.person + 1, frame.included.size() + heuristic(frame.potential), frame.included, frame.potential));
 		}
 
 		if (!has_current_person) continue;
@@ -88,71 +192,43 @@ vector<int> best_first_search(const vector<unordered_set<int>>& graph) {
 		for (int neighbour : graph[frame.person]) frame.potential.erase(neighbour);
 
 		const int right_bound = frame.included.size() + frame.potential.size();
-		if (right_bound > best_so_far.size()) {
-			to_visit.push(Context(frame.person + 1, frame.included.size() + heuristic(graph, frame.potential), frame.included, frame.potential));
+		if (right_bound > (int)best_so_far.size()) {
+			const int estimated_value = frame.included.size() + heuristic(frame.potential);
+			to_visit.push(Context(frame.person + 1, estimated_value, std::move(frame.included), std::move(frame.potential)));
 		}
 	}
 
 	return best_so_far;
 }
 
-int main() {
+int main(int argc, char** argv) {
 
-	int C; cin >> C;
-	vector<unordered_set<string>> clientLikes;
-	vector<unordered_set<string>> clientDislikes;
-	clientLikes.reserve(C);
-	clientDislikes.reserve(C);
+	const Options options(argc, argv);
+	const size_t memory_budget = options.has("memory-budget") ? parse_bytes(options.get("memory-budget")) : 0;
+	RunControl control(options);
+	telemetry.start_sampling(options);
 
-	for (int i = 0; i < C; ++i) {
-		int L; cin >> L;
-		unordered_set<string> likes;
-		for (int j = 0; j < L; ++j) {
-			string ingredient; cin >> ingredient;
-			likes.insert(ingredient);
-		}
-		clientLikes.push_back(likes);
-		int D; cin >> D;
-		unordered_set<string> dislikes;
-		for (int j = 0; j < D; ++j) {
-			string ingredient; cin >> ingredient;
-			dislikes.insert(ingredient);
-		}
-		clientDislikes.push_back(dislikes);
-	}
-
-	vector<unordered_set<int>> graph;
-	graph.reserve(C);
-	for (int i = 0; i < C; ++i) graph.push_back(unordered_set<int>());
-
-	for (int i = 0; i < C; ++i) {
-		for (int j = 0; j < C; ++j) {
-			if (i == j) continue;
-			for (string ingredient : clientLikes[i]) {
-				if (clientDislikes[j].count(ingredient) != 0) {
-					graph[i].insert(j);
-					graph[j].insert(i);
-					break;
-				}
-			}
-		}
-	}
+	const Instance instance = load_instance(options);
+	telemetry.enter(phase_graph);
+	instance.conflict_graph();
+	telemetry.enter(phase_search);
 
 	signal(SIGINT, sigint_handler);
 
-	const vector<int> clients = best_first_search(graph);
+	Frontier frontier(memory_budget);
+	const vector<int> clients = best_first_search(instance, frontier, control);
+	telemetry.enter(phase_output);
 	cerr << "Best First Search: " << clients.size() << endl;
-	unordered_set<string> ingredients;
-	for (int person : clients) {
-		for (string ingredient : clientLikes[person]) {
-			ingredients.insert(ingredient);
-		}
-	}
-	cout << ingredients.size();
-	for (string ingredient : ingredients) {
-		cout << " " << ingredient;
+	cerr << "Peak frontier: " << frontier.peak_nodes << " nodes, ~" << frontier.peak_bytes << " bytes" << endl;
+	if (frontier.evicted > 0) {
+		cerr << "Evicted " << frontier.evicted << " nodes with bounds up to " << frontier.evicted_bound << endl;
+		if (frontier.evicted_bound > clients.size()) cerr << "Optimality not proven: evicted nodes may still hold a better solution" << endl;
 	}
-	cout << endl;
+	control.report();
+	const string solution = solution_text(instance.ingredient_names(), instance.preferences.liked_ingredients(clients));
+	control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include "conflict_graph.h"
+#include "input.h"
+#include "preferences.h"
+#include <string>
+#include <vector>
+
+// A connected component of the conflict graph and the ingredients its clients
+// mention, both in ascending order. An ingredient mentioned by two components
+// is either liked by everyone who mentions it or disliked by everyone who
+// mentions it, since otherwise a client from each would conflict. So the
+// components can be solved independently and their answers merged with
+// merge_ingredients().
+typedef struct Component {
+	std::vector<int> clients;
+	std::vector<int> ingredients;
+} Component;
+
+// Largest first.
+std::vector<Component> find_components(const Instance& instance) {
+	const ConflictGraph& graph = instance.conflict_graph();
+	const Preferences& preferences = instance.preferences;
+	std::vector<char> seen(graph.size(), 0);
+	std::vector<size_t> footprint(instance.num_ingredients(), graph.size());
+	std::vector<Component> components;
+	for (size_t start = 0; start < graph.size(); ++start) {
+		if (seen[start]) continue;
+		Component component;
+		component.clients.push_back(start);
+		seen[start] = 1;
+		for (size_t i = 0; i < component.clients.size(); ++i) {
+			for (int neighbour : graph[component.clients[i]]) {
+				if (seen[neighbour]) continue;
+				seen[neighbour] = 1;
+				component.clients.push_back(neighbour);
+			}
+		}
+		std::sort(component.clients.begin(), component.clients.end());
+		for (int client : component.clients) {
+			for (const IdRange& mentions : {preferences.likes(client), preferences.dislikes(client)}) {
+				for (int ingredient : mentions) {
+					if (footprint[ingredient] == start) continue;
+					footprint[ingredient] = start;
+					component.ingredients.push_back(ingredient);
+				}
+			}
+		}
+		std::sort(component.ingredients.begin(), component.ingredients.end());
+		components.push_back(std::move(component));
+	}
+	std::stable_sort(components.begin(), components.end(), [](const Component& a, const Component& b) { return a.clients.size() > b.clients.size(); });
+	return components;
+}
+
+// The component as an instance of its own. Client i of the result is
+// component.clients[i] and ingredient j is component.ingredients[j].
+Instance component_instance(const Instance& instance, const Component& component) {
+	const Preferences& preferences = instance.preferences;
+	std::vector<int> local(instance.num_ingredients(), -1);
+	IngredientTable ingredients;
+	for (size_t i = 0; i < component.ingredients.size(); ++i) {
+		local[component.ingredients[i]] = i;
+		ingredients.intern(instance.ingredient_names()[component.ingredients[i]]);
+	}
+	std::vector<size_t> like_offsets(1, 0), dislike_offsets(1, 0);
+	std::vector<int> like_ids, dislike_ids;
+	for (int client : component.clients) {
+		for (int ingredient : preferences.likes(client)) like_ids.push_back(local[ingredient]);
+		like_offsets.push_back(like_ids.size());
+		for (int ingredient : preferences.dislikes(client)) dislike_ids.push_back(local[ingredient]);
+		dislike_offsets.push_back(dislike_ids.size());
+	}
+	const size_t num_ingredients = ingredients.size();
+	return Instance(std::move(ingredients), Preferences(num_ingredients, std::move(like_offsets), std::move(like_ids), std::move(dislike_offsets), std::move(dislike_ids)));
+}
+
+// The instance in the input format.
+std::string instance_text(const Instance& instance) {
+	const Preferences& preferences = instance.preferences;
+	std::string text = std::to_string(instance.num_clients()) + "\n";
+	for (size_t client = 0; client < instance.num_clients(); ++client) {
+		for (const IdRange& mentions : {preferences.likes(client), preferences.dislikes(client)}) {
+			text += std::to_string(mentions.size());
+			for (int ingredient : mentions) text += " " + instance.ingredient_names()[ingredient];
+			text += "\n";
+		}
+	}
+	return text;
+}
+
+// Combines ingredients chosen per component. Ingredients nobody dislikes are
+// always added and ingredients nobody likes always dropped; this is what keeps
+// an ingredient shared between components from hurting either of them.
+std::vector<char> merge_ingredients(const Preferences& preferences, std::vector<char> chosen) {
+	for (size_t ingredient = 0; ingredient < preferences.num_ingredients; ++ingredient) {
+		if (preferences.disliked_by(ingredient).empty()) chosen[ingredient] = 1;
+		else if (preferences.liked_by(ingredient).empty()) chosen[ingredient] = 0;
+	}
+	return chosen;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include "preferences.h"
+#include <vector>
+
+struct ConflictGraph {
+	CsrArray adjacency;
+
+	ConflictGraph() {}
+	ConflictGraph(CsrArray adjacency) : adjacency(std::move(adjacency)) {}
+
+	size_t size() const { return adjacency.size(); }
+	size_t num_edges() const { return adjacency.num_ids() / 2; }
+	size_t degree(size_t client) const { return adjacency.offsets[client + 1] - adjacency.offsets[client]; }
+	IdRange operator[](size_t client) const { return adjacency[client]; }
+	bool adjacent(int a, int b) const {
+		if (degree(a) > degree(b)) std::swap(a, b);
+		return (*this)[a].count(b) != 0;
+	}
+};
+
+ConflictGraph build_conflict_graph(const Preferences& preferences) {
+	const size_t num_clients = preferences.num_clients();
+	std::vector<size_t> offsets(1, 0);
+	std::vector<int> neighbours;
+	offsets.reserve(num_clients + 1);
+	std::vector<size_t> seen(num_clients, num_clients);
+	std::vector<int> row;
+	for (size_t client = 0; client < num_clients; ++client) {
+		row.clear();
+		auto visit = [&](int other) {
+			if (other == (int)client || seen[other] == client) return;
+			seen[other] = client;
+			row.push_back(other);
+		};
+		for (int ingredient : preferences.likes(client)) {
+			for (int other : preferences.disliked_by(ingredient)) visit(other);
+		}
+		for (int ingredient : preferences.dislikes(client)) {
+			for (int other : preferences.liked_by(ingredient)) visit(other);
+		}
+		std::sort(row.begin(), row.end());
+		neighbours.insert(neighbours.end(), row.begin(), row.end());
+		offsets.push_back(neighbours.size());
+	}
+	return ConflictGraph(CsrArray(std::move(offsets), std::move(neighbours)));
+}
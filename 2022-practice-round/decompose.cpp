@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include "components.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "heuristics.h"
+#include "independent_set.h"
+#include "input.h"
+#include <iostream>
+#include <map>
+#include "options.h"
+#include "run_control.h"
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// Usage: decompose <input> [--solver PATH] [--exact-size N] [--jobs N]
+//                  [--solver-args="ARGS"] [--time-limit SECS] [--seed N]
+//                  [--keep-work-dir]
+// Splits the instance into connected components of the conflict graph.
+// Components of at most --exact-size clients (default 64) are solved exactly
+// here. Each larger one is written out as an instance of its own and handed to
+// the solver binary, up to --jobs at a time, or solved with a heuristic when
+// there is no --solver. --time-limit and --seed are passed on to the solver
+// along with --solver-args. The metaheuristic solvers only stop when their
+// budget runs out, so without a --time-limit in either place each solver gets
+// 60 seconds; --time-limit 0 lifts the limit. The answers are merged into one
+// solution for the whole instance. The solvers' working files are deleted afterwards unless a
+// solver failed or --keep-work-dir is given.
+
+typedef struct Job {
+	size_t component;
+	string input;
+	string output;
+	string log;
+} Job;
+
+pid_t start_solver(const string& solver, const vector<string>& solver_args, const Job& job) {
+	vector<string> arguments = {solver, job.input};
+	arguments.insert(arguments.end(), solver_args.begin(), solver_args.end());
+	const pid_t pid = fork();
+	if (pid == 0) {
+		freopen(job.output.c_str(), "w", stdout);
+		freopen(job.log.c_str(), "w", stderr);
+		vector<char*> argv;
+		for (string& argument : arguments) argv.push_back(&argument[0]);
+		argv.push_back(nullptr);
+		execv(solver.c_str(), argv.data());
+		_exit(127);
+	}
+	return pid;
+}
+
+vector<string> split_arguments(const string& text) {
+	vector<string> arguments;
+	stringstream stream(text);
+	string argument;
+	while (stream >> argument) arguments.push_back(argument);
+	return arguments;
+}
+
+int main(int argc, char** argv) {
+
+	const Options options(argc, argv);
+	const string solver = options.get("solver");
+	const size_t exact_size = options.get_int("exact-size", 64);
+	const size_t jobs = max(1LL, options.get_int("jobs", thread::hardware_concurrency()));
+	vector<string> solver_args = {"--time-limit", "60"};
+	for (const string& argument : split_arguments(options.get("solver-args"))) solver_args.push_back(argument);
+	for (const char* forwarded : {"time-limit", "seed"}) {
+		if (!options.has(forwarded)) continue;
+		solver_args.push_back(string("--") + forwarded);
+		solver_args.push_back(options.get(forwarded));
+	}
+
+	const Instance instance = load_instance(options);
+	const vector<Component> components = find_components(instance);
+	cerr << "Components: " << components.size();
+	if (!components.empty()) cerr << ". Largest: " << components[0].clients.size() << " clients, " << components[0].ingredients.size() << " ingredients";
+	cerr << endl;
+
+	vector<char> chosen(instance.num_ingredients(), 0);
+	auto take = [&](const Component& component, const Instance& part, const vector<int>& clients) {
+		for (int client : clients) {
+			for (int ingredient : part.preferences.likes(client)) chosen[component.ingredients[ingredient]] = 1;
+		}
+	};
+	auto heuristic = [](const Instance& part) {
+		const unordered_set<int> clients = removeMostConflictingBucketed(part.conflict_graph());
+		return vector<int>(clients.begin(), clients.end());
+	};
+	vector<Instance> instances;
+	vector<Job> queued;
+	char work_template[] = "/tmp/pizza-components-XXXXXX";
+	string work_dir;
+
+	for (size_t i = 0; i < components.size(); ++i) {
+		const Component& component = components[i];
+		if (component.clients.size() <= exact_size || solver.empty()) {
+			const Instance part = component_instance(instance, component);
+			take(component, part, component.clients.size() <= exact_size ? maximum_independent_set(part.conflict_graph(), running) : heuristic(part));
+			continue;
+		}
+		if (work_dir.empty()) {
+			if (mkdtemp(work_template) == nullptr) {
+				cerr << "Could not create a working directory from " << work_template << ": " << strerror(errno) << endl;
+				exit(1);
+			}
+			work_dir = work_template;
+		}
+		const string prefix = work_dir + "/component" + to_string(i);
+		Job job{i, prefix + ".in.txt", prefix + ".out", prefix + ".log"};
+		instances.push_back(component_instance(instance, component));
+		ofstream(job.input) << instance_text(instances.back());
+		queued.push_back(job);
+	}
+	if (!solver.empty() && !queued.empty()) {
+		cerr << "Solving " << components.size() - queued.size() << " components exactly and " << queued.size() << " with " << solver << " in " << work_dir << endl;
+	}
+
+	bool keep_work_dir = options.has("keep-work-dir");
+	map<pid_t, size_t> active;
+	size_t next = 0;
+	while (next < queued.size() || !active.empty()) {
+		while (next < queued.size() && active.size() < jobs) {
+			active[start_solver(solver, solver_args, queued[next])] = next;
+			++next;
+		}
+		int status = 0;
+		const pid_t pid = wait(&status);
+		if (pid < 0) break;
+		const size_t index = active[pid];
+		active.erase(pid);
+		const Job& job = queued[index];
+		const Component& component = components[job.component];
+		const Instance& part = instances[index];
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			cerr << "Solver failed on component " << job.component << "; see " << job.log << ". Using a heuristic instead" << endl;
+			take(component, part, heuristic(part));
+			keep_work_dir = true;
+			continue;
+		}
+		for (int ingredient : load_solution(part, job.output)) chosen[component.ingredients[ingredient]] = 1;
+	}
+
+	if (!work_dir.empty() && !keep_work_dir) {
+		for (const Job& job : queued) {
+			for (const string& path : {job.input, job.output, job.log}) unlink(path.c_str());
+		}
+		rmdir(work_dir.c_str());
+	}
+
+	cout << solution_text(instance.ingredient_names(), merge_ingredients(instance.preferences, chosen));
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+constexpr size_t bitset_alignment = 64;
+constexpr size_t bitset_block_words = bitset_alignment / sizeof(uint64_t);
+
+size_t bitset_words_for(size_t num_bits) {
+	const size_t words = (num_bits + 63) >> 6;
+	return (words + bitset_block_words - 1) / bitset_block_words * bitset_block_words;
+}
+
+// All kernels take word counts that are a multiple of bitset_block_words and
+// pointers aligned to bitset_alignment.
+
+bool words_subset(const uint64_t* a, const uint64_t* b, size_t num_words) {
+#if defined(__AVX512F__)
+	for (size_t i = 0; i < num_words; i += 8) {
+		const __m512i extra = _mm512_andnot_si512(_mm512_load_si512(b + i), _mm512_load_si512(a + i));
+		if (_mm512_test_epi64_mask(extra, extra) != 0) return false;
+	}
+	return true;
+#elif defined(__AVX2__)
+	for (size_t i = 0; i < num_words; i += 4) {
+		const __m256i va = _mm256_load_si256((const __m256i*)(a + i));
+		const __m256i vb = _mm256_load_si256((const __m256i*)(b + i));
+		if (!_mm256_testc_si256(vb, va)) return false;
+	}
+	return true;
+#else
+	for (size_t i = 0; i < num_words; ++i) {
+		if ((a[i] & ~b[i]) != 0) return false;
+	}
+	return true;
+#endif
+}
+
+bool words_intersect(const uint64_t* a, const uint64_t* b, size_t num_words) {
+#if defined(__AVX512F__)
+	for (size_t i = 0; i < num_words; i += 8) {
+		if (_mm512_test_epi64_mask(_mm512_load_si512(a + i), _mm512_load_si512(b + i)) != 0) return true;
+	}
+	return false;
+#elif defined(__AVX2__)
+	for (size_t i = 0; i < num_words; i += 4) {
+		const __m256i va = _mm256_load_si256((const __m256i*)(a + i));
+		const __m256i vb = _mm256_load_si256((const __m256i*)(b + i));
+		if (!_mm256_testz_si256(va, vb)) return true;
+	}
+	return false;
+#else
+	for (size_t i = 0; i < num_words; ++i) {
+		if ((a[i] & b[i]) != 0) return true;
+	}
+	return false;
+#endif
+}
+
+size_t words_popcount(const uint64_t* a, size_t num_words) {
+#if defined(__AVX512VPOPCNTDQ__)
+	__m512i total = _mm512_setzero_si512();
+	for (size_t i = 0; i < num_words; i += 8) {
+		total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_load_si512(a + i)));
+	}
+	return _mm512_reduce_add_epi64(total);
+#else
+	size_t total = 0;
+	for (size_t i = 0; i < num_words; ++i) total += __builtin_popcountll(a[i]);
+	return total;
+#endif
+}
+
+bool words_equal(const uint64_t* a, const uint64_t* b, size_t num_words) {
+	return std::memcmp(a, b, num_words * sizeof(uint64_t)) == 0;
+}
+
+bool words_none(const uint64_t* a, size_t num_words) {
+	return !words_intersect(a, a, num_words);
+}
+
+class DynamicBitSet {
+	uint64_t* words;
+	size_t num_bits;
+	size_t num_words;
+
+	static uint64_t* allocate(size_t num_words) {
+		if (num_words == 0) return nullptr;
+		void* memory = std::aligned_alloc(bitset_alignment, num_words * sizeof(uint64_t));
+		if (memory == nullptr) throw std::bad_alloc();
+		return static_cast<uint64_t*>(memory);
+	}
+
+public:
+	DynamicBitSet() : words(nullptr), num_bits(0), num_words(0) {}
+
+	explicit DynamicBitSet(size_t num_bits) : words(allocate(bitset_words_for(num_bits))), num_bits(num_bits), num_words(bitset_words_for(num_bits)) {
+		if (num_words > 0) std::memset(words, 0, num_words * sizeof(uint64_t));
+	}
+
+	DynamicBitSet(const DynamicBitSet& other) : words(allocate(other.num_words)), num_bits(other.num_bits), num_words(other.num_words) {
+		if (num_words > 0) std::memcpy(words, other.words, num_words * sizeof(uint64_t));
+	}
+
+	DynamicBitSet(DynamicBitSet&& other) noexcept : words(other.words), num_bits(other.num_bits), num_words(other.num_words) {
+		other.words = nullptr;
+		other.num_bits = 0;
+		other.num_words = 0;
+	}
+
+	DynamicBitSet& operator=(const DynamicBitSet& other) {
+		if (this == &other) return *this;
+		if (num_words != other.num_words) {
+			std::free(words);
+			words = allocate(other.num_words);
+			num_words = other.num_words;
+		}
+		num_bits = other.num_bits;
+		if (num_words > 0) std::memcpy(words, other.words, num_words * sizeof(uint64_t));
+		return *this;
+	}
+
+	DynamicBitSet& operator=(DynamicBitSet&& other) noexcept {
+		std::swap(words, other.words);
+		std::swap(num_bits, other.num_bits);
+		std::swap(num_words, other.num_words);
+		return *this;
+	}
+
+	~DynamicBitSet() { std::free(words); }
+
+	size_t size() const { return num_bits; }
+	size_t word_count() const { return num_words; }
+	uint64_t* data() { return words; }
+	const uint64_t* data() const { return words; }
+
+	bool operator[](size_t index) const { return (words[index >> 6] >> (index & 63)) & 1; }
+	bool test(size_t index) const { return (*this)[index]; }
+
+	void set(size_t index, bool value = true) {
+		const uint64_t mask = uint64_t(1) << (index & 63);
+		if (value) words[index >> 6] |= mask;
+		else words[index >> 6] &= ~mask;
+	}
+	void reset(size_t index) { set(index, false); }
+	void flip(size_t index) { words[index >> 6] ^= uint64_t(1) << (index & 63); }
+
+	void clear_unused_bits() {
+		const size_t used_words = (num_bits + 63) >> 6;
+		if ((num_bits & 63) != 0) words[used_words - 1] &= (uint64_t(1) << (num_bits & 63)) - 1;
+		for (size_t i = used_words; i < num_words; ++i) words[i] = 0;
+	}
+
+	size_t count() const { return words_popcount(words, num_words); }
+	bool none() const { return words_none(words, num_words); }
+	bool any() const { return !none(); }
+
+	bool is_subset_of(const DynamicBitSet& other) const { return words_subset(words, other.words, num_words); }
+	bool intersects(const DynamicBitSet& other) const { return words_intersect(words, other.words, num_words); }
+
+	DynamicBitSet& operator|=(const DynamicBitSet& other) {
+		for (size_t i = 0; i < num_words; ++i) words[i] |= other.words[i];
+		return *this;
+	}
+
+	DynamicBitSet& operator&=(const DynamicBitSet& other) {
+		for (size_t i = 0; i < num_words; ++i) words[i] &= other.words[i];
+		return *this;
+	}
+
+	DynamicBitSet& subtract(const DynamicBitSet& other) {
+		for (size_t i = 0; i < num_words; ++i) words[i] &= ~other.words[i];
+		return *this;
+	}
+
+	friend bool operator==(const DynamicBitSet& l, const DynamicBitSet& r) {
+		return l.num_bits == r.num_bits && words_equal(l.words, r.words, l.num_words);
+	}
+
+	friend bool operator!=(const DynamicBitSet& l, const DynamicBitSet& r) { return !(l == r); }
+
+	friend bool operator<(const DynamicBitSet& l, const DynamicBitSet& r) {
+		return std::lexicographical_compare(l.words, l.words + l.num_words, r.words, r.words + r.num_words);
+	}
+};
+
+// Equally sized bitsets carved out of one aligned allocation. Each slot is
+// word_count() words long, so the kernels above apply to it directly.
+class BitSetArena {
+	uint64_t* words;
+	size_t num_sets;
+	size_t num_bits;
+	size_t num_words;
+
+public:
+	BitSetArena(size_t num_sets, size_t num_bits) : words(nullptr), num_sets(num_sets), num_bits(num_bits), num_words(bitset_words_for(num_bits)) {
+		const size_t total = num_sets * num_words;
+		if (total == 0) return;
+		words = static_cast<uint64_t*>(std::aligned_alloc(bitset_alignment, total * sizeof(uint64_t)));
+		if (words == nullptr) throw std::bad_alloc();
+		std::memset(words, 0, total * sizeof(uint64_t));
+	}
+
+	BitSetArena(const BitSetArena&) = delete;
+	BitSetArena& operator=(const BitSetArena&) = delete;
+
+	~BitSetArena() { std::free(words); }
+
+	size_t size() const { return num_sets; }
+	size_t bits() const { return num_bits; }
+	size_t word_count() const { return num_words; }
+	uint64_t* operator[](size_t index) { return words + index * num_words; }
+	const uint64_t* operator[](size_t index) const { return words + index * num_words; }
+};
@@ -1,8 +1,17 @@
 #include <algorithm>
+#include <atomic>
+#include "dynamic_bitset.h"
+#include "input.h"
 #include <iostream>
+#include "options.h"
+#include <memory>
+#include <mutex>
 #include <random>
+#include "run_control.h"
 #include <signal.h>
-#include <unordered_map>
+#include "spsc_queue.h"
+#include "telemetry.h"
+#include "thread_pool.h"
 #include <vector>
 
 using namespace std;
@@ -12,8 +21,7 @@ constexpr int pool_size = 1000;
 constexpr int keep_best = 100;
 constexpr int random_genes = 100;
 
-bool running = true;
-bool evolution_started = false;
+atomic<bool> evolution_started(false);
 
 void sigint_handler(int sig) {
 	running = false;
@@ -22,218 +30,268 @@ void sigint_handler(int sig) {
 	}
 }
 
-typedef struct BitSet {
-	vector<uint64_t> bits;
-	BitSet(const vector<uint64_t>& bits) : bits(bits) {}
-	BitSet(const size_t size) {
-		const size_t blocks = (size >> 6) + (((size & 63) > 0) ? 1 : 0);
-		bits = vector<uint64_t>(blocks, 0);
-	}
-
-	friend BitSet operator&(const BitSet& l, const BitSet& r) {
-		vector<uint64_t> result;
-		result.reserve(l.bits.size());
-		for (size_t i = 0; i < l.bits.size(); ++i) result.push_back(l.bits[i] & r.bits[i]);
-		return BitSet(result);
-	}
-
-	friend bool operator==(const BitSet& l, const BitSet& r) {
-		for (int i = 0; i < l.bits.size(); ++i) {
-			if (l.bits[i] != r.bits[i]) return false;
-		}
-		return true;
-	}
-
-	bool get(const size_t& index) {
-		const uint64_t block = bits[index >> 6];
-		return ((block >> (index & 63)) & 1) == 1;
-	}
-
-	void set(const size_t index, const bool value) {
-		if (value) {
-			bits[index >> 6] |= (1 << (index & 63));
-		}
-		else {
-			bits[index >> 6] &= ~(1 << (index & 63));
-		}
-	}
-
-	void flip(const size_t index) {
-		bits[index >> 6] ^= (1 << (index & 63));
-	}
-
-	bool empty() {
-		for (uint64_t block : bits) {
-			if (block != 0) return false;
-		}
-		return true;
-	}
-} BitSet;
+typedef DynamicBitSet BitSet;
 
+// Genes point into a BitSetArena, so copying or sorting them never touches
+// the heap.
 typedef struct Gene {
-	BitSet ingredients;
+	uint64_t* ingredients;
 	int fitness;
-	Gene(BitSet ingredients, int fitness) : ingredients(ingredients), fitness(fitness) {}
+	Gene() : ingredients(nullptr), fitness(0) {}
 	friend constexpr bool operator<(const Gene& a, const Gene& b) { return a.fitness < b.fitness; }
 } Gene;
 
 template <class Generator>
-const BitSet crossover(Generator& generator, const Gene& l, const Gene& r) {
-	uniform_int_distribution<int> dist(0, l.fitness + r.fitness - 1);
-	BitSet result = l.ingredients & r.ingredients;
-	for (size_t i = 0; i < result.bits.size(); ++i) {
-		if (dist(generator) < l.fitness) result.bits[i] |= l.ingredients.bits[i];
-		if (dist(generator) < r.fitness) result.bits[i] |= r.ingredients.bits[i];
+void crossover(Generator& generator, const Gene& l, const Gene& r, Gene& child, size_t num_bits) {
+	const int total_fitness = l.fitness + r.fitness;
+	uniform_int_distribution<int> dist(0, max(total_fitness - 1, 0));
+	const size_t blocks = (num_bits + 63) >> 6;
+	for (size_t i = 0; i < blocks; ++i) {
+		uint64_t word;
+		if (total_fitness == 0) {
+			word = (generator() & 1 ? l : r).ingredients[i];
+		}
+		else {
+			word = l.ingredients[i] & r.ingredients[i];
+			if (dist(generator) < l.fitness) word |= l.ingredients[i];
+			if (dist(generator) < r.fitness) word |= r.ingredients[i];
+		}
+		child.ingredients[i] = word;
 	}
 	uniform_real_distribution<double> real_dist(0.0, 1.0);
-	uniform_int_distribution<int> index_dist(0, 64 * result.bits.size() - 1);
+	uniform_int_distribution<size_t> index_dist(0, num_bits - 1);
 	while (real_dist(generator) < mutation_probability) {
-		result.flip(index_dist(generator));
+		const size_t index = index_dist(generator);
+		child.ingredients[index >> 6] ^= uint64_t(1) << (index & 63);
 	}
-	return result;
 }
 
-const int evaluate_fitness(const BitSet& ingredients, const vector<BitSet>& clientLikes, const vector<BitSet>& clientDislikes) {
+const int evaluate_fitness(const uint64_t* ingredients, const vector<BitSet>& clientLikes, const vector<BitSet>& clientDislikes) {
 	int satisfied = 0;
-	for (int client = 0; client < clientLikes.size(); ++client) {
-		if ((ingredients & clientLikes[client]) == clientLikes[client]) {
-			if ((ingredients & clientDislikes[client]).empty()) satisfied++;
-		}
+	for (size_t client = 0; client < clientLikes.size(); ++client) {
+		const size_t num_words = clientLikes[client].word_count();
+		if (words_subset(clientLikes[client].data(), ingredients, num_words) && !words_intersect(clientDislikes[client].data(), ingredients, num_words)) satisfied++;
 	}
 	return satisfied;
 }
 
 template <class Generator>
-const BitSet random_bitset(Generator& gen, size_t size) {
+void random_bitset(Generator& gen, uint64_t* words, size_t size) {
 	uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
 	const size_t blocks = (size >> 6) + (((size & 63) > 0) ? 1 : 0);
-	vector<uint64_t> bits; bits.reserve(blocks);
 	for (size_t block = 0; block < blocks; ++block) {
-		bits.push_back(dist(gen));
+		words[block] = dist(gen);
+	}
+	if ((size & 63) != 0) words[blocks - 1] &= (uint64_t(1) << (size & 63)) - 1;
+}
+
+void cumulative_fitness(const vector<Gene>& pool, vector<uint64_t>& cumulative) {
+	uint64_t total = 0;
+	for (size_t i = 0; i < pool.size(); ++i) {
+		total += pool[i].fitness;
+		cumulative[i] = total;
 	}
-	return BitSet(bits);
 }
 
 template <class Generator>
-Gene select_parent(Generator& gen, const vector<Gene>& pool) {
-	uint64_t total_fitness = 0;
-	for (Gene gene : pool) {
-		total_fitness += gene.fitness;
+const Gene& select_parent(Generator& gen, const vector<Gene>& pool, const vector<uint64_t>& cumulative) {
+	const uint64_t total_fitness = cumulative.back();
+	if (total_fitness == 0) {
+		uniform_int_distribution<size_t> index_dist(0, pool.size() - 1);
+		return pool[index_dist(gen)];
 	}
 	uniform_int_distribution<uint64_t> dist(0, total_fitness - 1);
-	size_t index = 0;
-	uint64_t cumulative_sum = pool[0].fitness;
-	uint64_t random_number = dist(gen);
-	while (cumulative_sum < random_number) {
-		index++;
-		cumulative_sum += pool[index].fitness;
-	}
+	const size_t index = upper_bound(cumulative.begin(), cumulative.end(), dist(gen)) - cumulative.begin();
 	return pool[index];
 }
 
-int main() {
+typedef struct Migrant {
+	vector<uint64_t> ingredients;
+	int fitness;
+} Migrant;
+
+typedef SpscQueue<Migrant> MigrationQueue;
+
+// One sub-population with its own generator and gene storage. Islands only
+// interact through their migration queues.
+typedef struct Island {
+	BitSetArena arena;
+	vector<Gene> pool;
+	vector<Gene> new_pool;
+	vector<uint64_t> cumulative;
+	mt19937_64 gen;
+	Island(size_t num_ingredients, uint64_t seed) : arena(2 * pool_size, num_ingredients), pool(pool_size), new_pool(pool_size), cumulative(pool_size), gen(seed) {
+		for (int i = 0; i < pool_size; ++i) {
+			pool[i].ingredients = arena[i];
+			new_pool[i].ingredients = arena[pool_size + i];
+		}
+	}
+} Island;
+
+// Seeds fill the first genes and the rest are random.
+void initialise(Island& island, const vector<vector<int>>& seeds, const vector<BitSet>& clientLikes, const vector<BitSet>& clientDislikes) {
+	for (size_t i = 0; i < island.pool.size(); ++i) {
+		Gene& gene = island.pool[i];
+		if (i < seeds.size()) {
+			fill(gene.ingredients, gene.ingredients + island.arena.word_count(), 0);
+			for (int ingredient : seeds[i]) gene.ingredients[ingredient >> 6] |= uint64_t(1) << (ingredient & 63);
+		}
+		else {
+			random_bitset(island.gen, gene.ingredients, island.arena.bits());
+		}
+		gene.fitness = evaluate_fitness(gene.ingredients, clientLikes, clientDislikes);
+	}
+	sort(island.pool.begin(), island.pool.end());
+}
 
-	signal(SIGINT, sigint_handler);
+void evolve(Island& island, const vector<BitSet>& clientLikes, const vector<BitSet>& clientDislikes) {
+	vector<Gene>& pool = island.pool;
+	vector<Gene>& new_pool = island.new_pool;
+	const size_t num_ingredients = island.arena.bits();
+	cumulative_fitness(pool, island.cumulative);
+	size_t next = 0;
+	for (size_t i = 0; i < keep_best; ++i) {
+		Gene& elite = new_pool[next++];
+		copy(pool[pool_size - 1 - i].ingredients, pool[pool_size - 1 - i].ingredients + island.arena.word_count(), elite.ingredients);
+		elite.fitness = pool[pool_size - 1 - i].fitness;
+	}
+	for (size_t i = 0; i < random_genes; ++i) {
+		Gene& gene = new_pool[next++];
+		random_bitset(island.gen, gene.ingredients, num_ingredients);
+		gene.fitness = evaluate_fitness(gene.ingredients, clientLikes, clientDislikes);
+	}
+	while (next < pool_size) {
+		Gene& child = new_pool[next++];
+		crossover(island.gen, select_parent(island.gen, pool, island.cumulative), select_parent(island.gen, pool, island.cumulative), child, num_ingredients);
+		child.fitness = evaluate_fitness(child.ingredients, clientLikes, clientDislikes);
+	}
+	swap(pool, new_pool);
+	sort(pool.begin(), pool.end());
+}
 
-	random_device dev;
-	mt19937_64 gen(dev());
+// Sends copies of the best genes. Migrants that do not fit in the queue are
+// dropped rather than waited for.
+void emigrate(const Island& island, MigrationQueue& queue, size_t count) {
+	for (size_t i = 0; i < count && i < island.pool.size(); ++i) {
+		Migrant* migrant = queue.producer_slot();
+		if (migrant == nullptr) return;
+		const Gene& gene = island.pool[pool_size - 1 - i];
+		copy(gene.ingredients, gene.ingredients + island.arena.word_count(), migrant->ingredients.begin());
+		migrant->fitness = gene.fitness;
+		queue.publish();
+	}
+}
 
-	int C; cin >> C;
+// Arrivals replace the worst genes.
+void immigrate(Island& island, MigrationQueue& queue) {
+	size_t replaced = 0;
+	while (replaced < island.pool.size()) {
+		const Migrant* migrant = queue.consumer_slot();
+		if (migrant == nullptr) break;
+		Gene& gene = island.pool[replaced++];
+		copy(migrant->ingredients.begin(), migrant->ingredients.end(), gene.ingredients);
+		gene.fitness = migrant->fitness;
+		queue.release();
+	}
+	if (replaced > 0) sort(island.pool.begin(), island.pool.end());
+}
 
-	vector<vector<string>> clientLikeNames; clientLikeNames.reserve(C);
-	vector<vector<string>> clientDislikeNames; clientDislikeNames.reserve(C);
+int main(int argc, char** argv) {
 
-	unordered_map<string, int> ingredient_ids;
-	vector<string> ingredient_names;
+	const Options options(argc, argv);
+	RunControl control(options);
+	telemetry.start_sampling(options);
 
-	for (int client = 0; client < C; ++client) {
-		int L; cin >> L;
-		vector<string> likes; likes.reserve(L);
-		for (int i = 0; i < L; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = ingredient_names.size();
-				ingredient_names.push_back(name);
-			}
-			likes.push_back(name);
-		}	
-		clientLikeNames.push_back(likes);
-
-		int D; cin >> D;
-		vector<string> dislikes; dislikes.reserve(D);
-		for (int i = 0; i < D; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = ingredient_names.size();
-				ingredient_names.push_back(name);
-			}
-			dislikes.push_back(name);
-		}
-		clientDislikeNames.push_back(dislikes);
-	}
+	signal(SIGINT, sigint_handler);
+
+	random_device dev;
+	mt19937_64 gen(dev());
+	if (options.has("seed")) gen.seed(options.get_int("seed", 0));
+
+	const Instance instance = load_instance(options);
+	const Preferences& preferences = instance.preferences;
+	const vector<string>& ingredient_names = instance.ingredient_names();
+	const size_t C = instance.num_clients();
 
 	vector<BitSet> clientLikes; clientLikes.reserve(C);
 	vector<BitSet> clientDislikes; clientDislikes.reserve(C);
 
-	for (vector<string> like_names : clientLikeNames) {
+	for (size_t client = 0; client < C; ++client) {
 		BitSet likes(ingredient_names.size());
-		for (string name : like_names) {
-			likes.set(ingredient_ids[name], true);
+		for (int ingredient : preferences.likes(client)) {
+			likes.set(ingredient);
 		}
 		clientLikes.push_back(likes);
-	}
 
-	for (vector<string> dislike_names : clientDislikeNames) {
 		BitSet dislikes(ingredient_names.size());
-		for (string name : dislike_names) {
-			dislikes.set(ingredient_ids[name], true);
+		for (int ingredient : preferences.dislikes(client)) {
+			dislikes.set(ingredient);
 		}
 		clientDislikes.push_back(dislikes);
 	}
 
 	cerr << "Creating initial gene pool..." << endl;
 
-	vector<Gene> pool; pool.reserve(pool_size);
-	for (int i = 0; i < pool_size; ++i) {
-		const BitSet ingredients = random_bitset(gen, ingredient_names.size());
-		const int fitness = evaluate_fitness(ingredients, clientLikes, clientDislikes);
-		pool.push_back(Gene(ingredients, fitness));
+	const size_t num_ingredients = ingredient_names.size();
+	const size_t num_islands = max(1LL, options.get_int("islands", 1));
+	const size_t migration_interval = max(1LL, options.get_int("migration-interval", 10));
+	const size_t migration_size = options.get_int("migration-size", 5);
+	const vector<vector<int>> seeds = load_initial_solutions(options, instance);
+
+	vector<unique_ptr<Island>> islands;
+	vector<unique_ptr<MigrationQueue>> inboxes;
+	const Migrant prototype{vector<uint64_t>(bitset_words_for(num_ingredients)), 0};
+	for (size_t i = 0; i < num_islands; ++i) {
+		islands.emplace_back(new Island(num_ingredients, gen()));
+		inboxes.emplace_back(new MigrationQueue(2 * migration_size, prototype));
 	}
-	sort(pool.begin(), pool.end());
 
-	evolution_started = true;
-	int generation = 0;
-
-	while (running) {
-		generation++;
-		cerr << "Generation " << generation << ". Best fitness: " << pool.back().fitness << endl;
-		vector<Gene> newPool; newPool.reserve(pool_size);
-		for (size_t i = 0; i < keep_best; ++i) {
-			newPool.push_back(pool[pool_size - 1 - i]);
-		}
-		for (size_t i = 0; i < random_genes; ++i) {
-			BitSet ingredients = random_bitset(gen, ingredient_names.size());
-			newPool.push_back(Gene(ingredients, evaluate_fitness(ingredients, clientLikes, clientDislikes)));
+	mutex best_lock;
+	BitSet best_ingredients(num_ingredients);
+	atomic<int> best_fitness(0);
+	auto offer = [&](const Gene& gene) {
+		if (gene.fitness <= best_fitness.load(memory_order_relaxed)) return;
+		lock_guard<mutex> locker(best_lock);
+		if (gene.fitness <= best_fitness.load(memory_order_relaxed)) return;
+		copy(gene.ingredients, gene.ingredients + best_ingredients.word_count(), best_ingredients.data());
+		best_fitness.store(gene.fitness, memory_order_relaxed);
+	};
+
+	telemetry.enter(phase_seeding);
+	ThreadPool workers(num_islands);
+	workers.run([&](size_t worker) {
+		Island& island = *islands[worker];
+		initialise(island, seeds, clientLikes, clientDislikes);
+		telemetry.add(evaluations, pool_size, worker);
+		if (worker == 0) {
+			evolution_started = true;
+			telemetry.enter(phase_search);
 		}
-		for (size_t i = 0; i < pool_size - keep_best - random_genes; ++i) {
-			Gene parent_a = select_parent(gen, pool);
-			Gene parent_b = select_parent(gen, pool);
-			BitSet ingredients = crossover(gen, parent_a, parent_b);
-			pool.push_back(Gene(ingredients, evaluate_fitness(ingredients, clientLikes, clientDislikes)));
+		for (size_t generation = 1; running; ++generation) {
+			offer(island.pool.back());
+			telemetry.improve(island.pool.back().fitness);
+			if (control.checkpoint_due()) {
+				lock_guard<mutex> locker(best_lock);
+				control.checkpoint(solution_text(ingredient_names, best_ingredients));
+			}
+			if (num_islands > 1) {
+				immigrate(island, *inboxes[worker]);
+				if (generation % migration_interval == 0) emigrate(island, *inboxes[(worker + 1) % num_islands], migration_size);
+			}
+			evolve(island, clientLikes, clientDislikes);
+			telemetry.add(evaluations, pool_size - keep_best, worker);
+			control.tick();
 		}
-		sort(pool.begin(), pool.end());
-	}
-
-	BitSet ingredients = pool.back().ingredients;
-	size_t ingredient_count = 0;
-	for (size_t i = 0; i < ingredient_names.size(); ++i) {
-		if (ingredients.get(i)) ingredient_count++;
-	}
-	cout << ingredient_count;
-	for (size_t i = 0; i < ingredient_names.size(); ++i) {
-		if (ingredients.get(i)) cout << " " << ingredient_names[i];
-	}
-	cout << endl;
+	});
+
+	for (const auto& island : islands) offer(island->pool.back());
+	telemetry.improve(best_fitness.load(memory_order_relaxed));
+	telemetry.enter(phase_output);
+	control.report();
+	const string solution = solution_text(ingredient_names, best_ingredients);
+	control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
 
 	return 0;
 }
\ No newline at end of file
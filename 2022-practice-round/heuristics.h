@@ -1,87 +1,128 @@
 #pragma once
 
+#include <algorithm>
 #include <random>
 #include <unordered_set>
 #include <vector>
 
-std::unordered_set<int> randomResolution(const std::vector<std::unordered_set<int>>& graph) {
+// Repeatedly picks a uniformly random edge between satisfied people and drops
+// one of its endpoints. Edges are sampled from a list; an edge with a removed
+// endpoint is swapped out when it is drawn, so each edge is discarded once.
+template <class Graph>
+std::unordered_set<int> randomResolution(const Graph& graph) {
 	std::random_device dev;
 	std::mt19937 gen(dev());
 	std::uniform_int_distribution<int> random_bool(0, 1);
 
-	std::unordered_set<int> satisfied;
-	for (int i = 0; i < graph.size(); ++i) satisfied.insert(i);
-	bool hasConflict = true;
-	while (hasConflict) {
-		hasConflict = false;
-		for (auto a : satisfied) {
-			for (auto b : satisfied) {
-				if (graph[a].count(b) != 0) {
-					bool removeA = random_bool(gen);
-					satisfied.erase(removeA ? a : b);
-					hasConflict = true;
-					break;
-				}
-			}
-			if (hasConflict) break;
+	const int n = graph.size();
+	std::vector<std::pair<int, int>> edges;
+	for (int a = 0; a < n; ++a) {
+		for (auto b : graph[a]) {
+			if (a < b) edges.push_back(std::make_pair(a, (int)b));
 		}
 	}
+	std::vector<char> removed(n, 0);
+	while (edges.size() > 0) {
+		std::uniform_int_distribution<size_t> dist(0, edges.size() - 1);
+		const size_t index = dist(gen);
+		const int a = edges[index].first;
+		const int b = edges[index].second;
+		if (!removed[a] && !removed[b]) {
+			bool removeA = random_bool(gen);
+			removed[removeA ? a : b] = 1;
+		}
+		edges[index] = edges.back();
+		edges.pop_back();
+	}
+
+	std::unordered_set<int> satisfied;
+	for (int i = 0; i < n; ++i) {
+		if (!removed[i]) satisfied.insert(i);
+	}
 	return satisfied;
 }
 
-std::unordered_set<int> uniformRandomResolution(const std::vector<std::unordered_set<int>>& graph) {
+// Repeatedly drops a uniformly random person who still conflicts with another
+// satisfied person. Conflicting people are kept in an indexed array together
+// with their number of satisfied neighbours, so a removal only visits its
+// neighbours.
+template <class Graph>
+std::unordered_set<int> uniformRandomResolution(const Graph& graph) {
 	std::random_device dev;
 	std::mt19937 gen(dev());
 
-	std::unordered_set<int> satisfied;
-	for (int i = 0; i < graph.size(); ++i) satisfied.insert(i);
-	while (true) {
-		std::vector<int> conflicts;
-		for (auto a : satisfied) {
-			for (auto b : satisfied) {
-				if (graph[a].count(b) != 0) {
-					conflicts.push_back(a);
-					break;
-				}
-			}
+	const int n = graph.size();
+	std::vector<int> conflicts(n, 0);
+	std::vector<int> position(n, -1);
+	std::vector<int> conflicting;
+	std::vector<char> removed(n, 0);
+	for (int i = 0; i < n; ++i) {
+		for (auto neighbour : graph[i]) {
+			if (neighbour != i) ++conflicts[i];
+		}
+		if (conflicts[i] > 0) {
+			position[i] = conflicting.size();
+			conflicting.push_back(i);
+		}
+	}
+	auto stopConflicting = [&](int person) {
+		const int last = conflicting.back();
+		conflicting[position[person]] = last;
+		position[last] = position[person];
+		conflicting.pop_back();
+		position[person] = -1;
+	};
+	while (conflicting.size() > 0) {
+		std::uniform_int_distribution<int> dist(0, conflicting.size() - 1);
+		const int person = conflicting[dist(gen)];
+		removed[person] = 1;
+		stopConflicting(person);
+		for (auto neighbour : graph[person]) {
+			if (removed[neighbour] || neighbour == person) continue;
+			if (--conflicts[neighbour] == 0) stopConflicting(neighbour);
 		}
-		if (conflicts.size() == 0) break;
-		std::uniform_int_distribution<int> dist(0, conflicts.size() - 1);
-		satisfied.erase(conflicts[dist(gen)]);
+	}
+
+	std::unordered_set<int> satisfied;
+	for (int i = 0; i < n; ++i) {
+		if (!removed[i]) satisfied.insert(i);
 	}
 	return satisfied;
 }
 
-template <typename T>
-std::unordered_set<T> removeMostConflicting(std::vector<std::unordered_set<T> > graph) {
-	std::unordered_set<T> satisfied;
-	for (T i = 0; i < graph.size(); ++i) satisfied.insert(i);
+template <class Graph>
+std::unordered_set<int> removeMostConflicting(const Graph& graph) {
+	std::unordered_set<int> satisfied;
+	std::vector<int> conflicts(graph.size());
+	for (int i = 0; i < (int)graph.size(); ++i) {
+		satisfied.insert(i);
+		conflicts[i] = graph[i].size();
+	}
 	while (true) {
 		int maxConflicts = 0;
 		int mostConflictingPerson = -1;
-		for (T person : satisfied) {
-			int numConflicts = graph[person].size();
-			if (numConflicts > maxConflicts) {
-				maxConflicts = numConflicts;
+		for (int person : satisfied) {
+			if (conflicts[person] > maxConflicts) {
+				maxConflicts = conflicts[person];
 				mostConflictingPerson = person;
 			}
 		}
 		if (maxConflicts == 0) break;
 		satisfied.erase(mostConflictingPerson);
-		for (auto& node : graph) node.erase(mostConflictingPerson);
+		for (auto person : graph[mostConflictingPerson]) --conflicts[person];
 	}
 	return satisfied;
 }
 
-template <typename T>
-std::unordered_set<T> addLeastConflicting(const std::vector<std::unordered_set<T>>& graph) {
-	std::unordered_set<T> satisfied;
-	std::unordered_set<T> potential;
-	for (T i = 0; i < graph.size(); ++i) potential.insert(i);
+template <class Graph>
+std::unordered_set<int> addLeastConflicting(const Graph& graph) {
+	std::unordered_set<int> satisfied;
+	std::unordered_set<int> potential;
+	for (int i = 0; i < (int)graph.size(); ++i) potential.insert(i);
 	while (potential.size() > 0) {
 		int leastConflicts = graph.size() + 1;
 		int leastConflictingPerson = -1;
-		for (T person : potential) {
+		for (int person : potential) {
 			int numConflicts = graph[person].size();
 			if (numConflicts < leastConflicts) {
 				leastConflicts = numConflicts;
@@ -95,16 +136,79 @@ std::unordered_set<T> addLeastConflicting(const std::vector<std::unordered_set<T
 	return satisfied;
 }
 
-template <class DislikesType>
-std::unordered_set<int> leastDislikes(const std::vector<std::unordered_set<int>>& graph, const std::vector<DislikesType>& clientDislikes) {
+// O(V + E) versions of the two heuristics above. Vertices sit in doubly linked
+// per-degree buckets; removing one only moves its neighbours down a bucket.
+template <class Graph>
+std::unordered_set<int> removeMostConflictingBucketed(const Graph& graph) {
+	const int n = graph.size();
+	std::vector<int> conflicts(n), next(n), previous(n), head(n + 1, -1);
+	std::vector<char> removed(n, 0);
+	auto unlink = [&](int person) {
+		if (previous[person] >= 0) next[previous[person]] = next[person];
+		else head[conflicts[person]] = next[person];
+		if (next[person] >= 0) previous[next[person]] = previous[person];
+	};
+	auto link = [&](int person) {
+		previous[person] = -1;
+		next[person] = head[conflicts[person]];
+		if (next[person] >= 0) previous[next[person]] = person;
+		head[conflicts[person]] = person;
+	};
+	int maxConflicts = 0;
+	for (int i = 0; i < n; ++i) {
+		conflicts[i] = graph[i].size();
+		link(i);
+		maxConflicts = std::max(maxConflicts, conflicts[i]);
+	}
+	while (true) {
+		while (maxConflicts > 0 && head[maxConflicts] < 0) --maxConflicts;
+		if (maxConflicts == 0) break;
+		const int mostConflictingPerson = head[maxConflicts];
+		unlink(mostConflictingPerson);
+		removed[mostConflictingPerson] = 1;
+		for (auto person : graph[mostConflictingPerson]) {
+			if (removed[person]) continue;
+			unlink(person);
+			--conflicts[person];
+			link(person);
+		}
+	}
+	std::unordered_set<int> satisfied;
+	for (int i = 0; i < n; ++i) {
+		if (!removed[i]) satisfied.insert(i);
+	}
+	return satisfied;
+}
+
+template <class Graph>
+std::unordered_set<int> addLeastConflictingBucketed(const Graph& graph) {
+	const int n = graph.size();
+	std::vector<int> start(n + 2, 0);
+	for (int i = 0; i < n; ++i) ++start[graph[i].size() + 1];
+	for (int degree = 0; degree <= n; ++degree) start[degree + 1] += start[degree];
+	std::vector<int> order(n);
+	for (int i = 0; i < n; ++i) order[start[graph[i].size()]++] = i;
+
+	std::unordered_set<int> satisfied;
+	std::vector<char> blocked(n, 0);
+	for (int person : order) {
+		if (blocked[person]) continue;
+		satisfied.insert(person);
+		for (auto neighbour : graph[person]) blocked[neighbour] = 1;
+	}
+	return satisfied;
+}
+
+template <class Graph, class DislikesType>
+std::unordered_set<int> leastDislikes(const Graph& graph, const std::vector<DislikesType>& clientDislikes) {
 	std::unordered_set<int> satisfied;
 	std::unordered_set<int> potential;
-	for (int i = 0; i < clientDislikes.size(); ++i) potential.insert(i);
+	for (int i = 0; i < (int)clientDislikes.size(); ++i) potential.insert(i);
 	while (potential.size() > 0) {
 		int leastDislikes = -1;
 		int leastFussyPerson = -1;
 		for (int person : potential) {
-			if (leastDislikes == -1 || clientDislikes[person].size() < leastDislikes) {
+			if (leastDislikes == -1 || (int)clientDislikes[person].size() < leastDislikes) {
 				leastDislikes = clientDislikes[person].size();
 				leastFussyPerson = person;
 			}
@@ -116,20 +220,20 @@ std::unordered_set<int> leastDislikes(const std::vector<std::unordered_set<int>>
 	return satisfied;
 }
 
-template <class LikesType, class DislikesType>
+template <class Graph, class LikesType, class DislikesType>
 std::unordered_set<int> fewestPreferences(
-	const std::vector<std::unordered_set<int>>& graph, 
+	const Graph& graph, 
 	const std::vector<LikesType>& clientLikes,
 	const std::vector<DislikesType>& clientDislikes
 ) {
 	std::unordered_set<int> satisfied;
 	std::unordered_set<int> potential;
-	for (int i = 0; i < clientDislikes.size(); ++i) potential.insert(i);
+	for (int i = 0; i < (int)clientDislikes.size(); ++i) potential.insert(i);
 	while (potential.size() > 0) {
 		int fewestPreferences = -1;
 		int leastFussyPerson = -1;
 		for (int person : potential) {
-			if (fewestPreferences== -1 || clientDislikes[person].size() + clientLikes[person].size() < fewestPreferences) {
+			if (fewestPreferences== -1 || (int)(clientDislikes[person].size() + clientLikes[person].size()) < fewestPreferences) {
 				fewestPreferences = clientDislikes[person].size() + clientLikes[person].size();
 				leastFussyPerson = person;
 			}
@@ -1,20 +1,27 @@
 #include <algorithm>
-#include <bitset>
+#include "conflict_graph.h"
+#include "dynamic_bitset.h"
 #include "heuristics.h"
+#include "incremental_fitness.h"
+#include "ingredient_reduction.h"
+#include "input.h"
 #include <iostream>
+#include "options.h"
 #include <random>
+#include "run_control.h"
 #include <signal.h>
-#include <unordered_map>
+#include "telemetry.h"
 #include <unordered_set>
 #include <vector>
+#include "thread_pool.h"
 
 using namespace std;
 
 constexpr int pool_size = 1000;
 constexpr double bit_flip_probability = 0.5;
 constexpr double client_satisfaction_probability = 0.5;
+constexpr size_t num_streams = 64;
 
-bool running = true;
 bool evolution_started = false;
 
 void sigint_handler(int sig) {
@@ -34,28 +41,24 @@ struct seed {
 	seed() : dev{} {}
 };
 
-typedef bitset<10000> bits;
+typedef DynamicBitSet bits;
 
 typedef struct Gene {
 	bits ingredients;
 	size_t fitness;
-	Gene(bits ingredients, size_t fitness) : ingredients(ingredients), fitness(fitness) {}
-	friend constexpr bool operator<(const Gene& a, const Gene& b) {
+	Gene() : fitness(0) {}
+	Gene(bits ingredients, size_t fitness) : ingredients(std::move(ingredients)), fitness(fitness) {}
+	friend bool operator<(const Gene& a, const Gene& b) {
 		if (a.fitness != b.fitness) return a.fitness < b.fitness;
-		for (size_t i = 0; i < 10000; ++i) {
-			if (a.ingredients[i] != b.ingredients[i]) return a.ingredients[i] < b.ingredients[i];
-		}
-		return false;
+		return a.ingredients < b.ingredients;
 	}
 } Gene;
 
 const size_t evaluate_fitness(const bits& ingredients, const vector<bits>& client_likes, const vector<bits>& client_dislikes) {
 	size_t satisfied = 0;
 	for (size_t client = 0; client < client_likes.size(); ++client) {
-		if ((ingredients & client_likes[client]) == client_likes[client]) {
-			if ((ingredients & client_dislikes[client]).none()) {
-				++satisfied;
-			}
+		if (client_likes[client].is_subset_of(ingredients) && !client_dislikes[client].intersects(ingredients)) {
+			++satisfied;
 		}
 	}
 	return satisfied;
@@ -63,124 +66,135 @@ const size_t evaluate_fitness(const bits& ingredients, const vector<bits>& clien
 
 template <class Generator>
 const bits random_bitset(Generator& generator, size_t num_ingredients) {
-	bits result;
+	bits result(num_ingredients);
 	bernoulli_distribution dist(0.5);
 
 	for (size_t i = 0; i < num_ingredients; ++i) {
-		result[i] = dist(generator);
+		result.set(i, dist(generator));
 	}
 
 	return result;
 }
 
-const bits ingredients_from_client_set(const unordered_set<size_t>& clients, const vector<bits>& client_likes) {
-	bits ingredients;
-	for (size_t client: clients) {
+const bits ingredients_from_client_set(const unordered_set<int>& clients, const vector<bits>& client_likes, const size_t num_ingredients) {
+	bits ingredients(num_ingredients);
+	for (int client: clients) {
 		ingredients |= client_likes[client];
 	}
 	return ingredients;
 }
 
+const bits ingredients_from_ids(const vector<int>& ingredients, const size_t num_ingredients) {
+	bits result(num_ingredients);
+	for (int ingredient : ingredients) {
+		result.set(ingredient);
+	}
+	return result;
+}
+
 template <class Generator>
-const bits flip_random_bits(Generator& generator, const bits current_bits, const size_t num_ingredients) {
+const bits flip_random_bits(Generator& generator, const bits& current_bits, const size_t num_ingredients, vector<int>& changed) {
 	bits new_bits(current_bits);
 	uniform_int_distribution<size_t> dist(0, num_ingredients - 1);
 	uniform_real_distribution<double> real_dist(0, 1);
+	changed.clear();
 	do {
-		new_bits.flip(dist(generator));
+		const size_t index = dist(generator);
+		new_bits.flip(index);
+		changed.push_back(index);
 	} while (real_dist(generator) < bit_flip_probability);
 	return new_bits;
 }
 
 template <class Generator>
-const bits satisfy_random_clients(Generator& generator, const bits current_bits, const vector<bits>& client_likes, const vector<bits>& client_dislikes) {
-	uniform_int_distribution<size_t> dist(0, client_likes.size() - 1);
+const bits satisfy_random_clients(Generator& generator, const bits& current_bits, const Preferences& preferences, vector<int>& changed) {
+	uniform_int_distribution<size_t> dist(0, preferences.num_clients() - 1);
 	uniform_real_distribution<double> real_dist(0, 1);
 	bits result = bits(current_bits);
+	changed.clear();
 	do {
 		const size_t client_index = dist(generator);
-		result |= client_likes[client_index];
-		result &= (~client_dislikes[client_index]);
+		for (int ingredient : preferences.likes(client_index)) {
+			result.set(ingredient);
+			changed.push_back(ingredient);
+		}
+		for (int ingredient : preferences.dislikes(client_index)) {
+			result.reset(ingredient);
+			changed.push_back(ingredient);
+		}
 	} while (real_dist(generator) < client_satisfaction_probability);
 	return result;
 }
 
-int main() {
+int main(int argc, char** argv) {
 
+	const Options options(argc, argv);
 	struct seed seeder;
 	mt19937_64 generator(seeder);
+	if (options.has("seed")) generator.seed(options.get_int("seed", 0));
+	const size_t num_threads = max(1LL, options.get_int("threads", 1));
+	RunControl control(options);
+	telemetry.start_sampling(options);
 
 	signal(SIGINT, sigint_handler);
 
-	size_t num_clients; cin >> num_clients;
-
-	unordered_map<string, size_t> ingredient_ids;
-	vector<string> ingredient_names;
-	size_t num_ingredients = 0;
+	const Instance original = load_instance(options);
+	const IngredientReduction reduction = reduce_ingredients(original);
+	const Instance& instance = reduction.instance;
+	const Preferences& preferences = instance.preferences;
+	auto text = [&](const bits& ingredients) { return solution_text(original.ingredient_names(), reduction.expand(ingredients)); };
+	const size_t num_clients = instance.num_clients();
+	const size_t num_ingredients = instance.num_ingredients();
+	cerr << "Ingredients: " << original.num_ingredients() << ". Variables: " << num_ingredients << " (" << reduction.num_fixed_on << " fixed on, " << reduction.num_fixed_off << " fixed off)" << endl;
+	if (num_ingredients == 0) {
+		cout << text(bits(0));
+		telemetry.stop();
+		return 0;
+	}
 
 	vector<bits> client_likes;
 	client_likes.reserve(num_clients);
 	vector<bits> client_dislikes;
 	client_dislikes.reserve(num_clients);
-
-	for (int client = 0; client < num_clients; ++client) {
-		int num_likes; cin >> num_likes;
-		bits current_likes;
-		for (int i = 0; i < num_likes; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = num_ingredients++;
-				ingredient_names.push_back(name);
-			}
-			current_likes[ingredient_ids[name]] = true;
-		}
+	for (size_t client = 0; client < num_clients; ++client) {
+		bits current_likes(num_ingredients);
+		for (int ingredient : preferences.likes(client)) current_likes.set(ingredient);
 		client_likes.push_back(current_likes);
-
-		int num_dislikes; cin >> num_dislikes;
-		bits current_dislikes;
-		for (int i = 0; i < num_dislikes; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = num_ingredients++;
-				ingredient_names.push_back(name);
-			}
-			current_dislikes[ingredient_ids[name]] = true;
-		}
+		bits current_dislikes(num_ingredients);
+		for (int ingredient : preferences.dislikes(client)) current_dislikes.set(ingredient);
 		client_dislikes.push_back(current_dislikes);
 	}
 
-	vector<unordered_set<size_t>> conflict_graph;
-	conflict_graph.reserve(num_clients);
-	for (size_t i = 0; i < num_clients; ++i) conflict_graph.push_back(unordered_set<size_t>());
-
-	for (size_t i = 0; i < num_clients; ++i) {
-		for (size_t j = 0; j < num_clients; ++j) {
-			if (i == j) continue;
-			if (!(client_likes[i] & client_dislikes[j]).none()) {
-				conflict_graph[i].insert(j);
-				conflict_graph[j].insert(i);
-			}
-		}
-	}
+	telemetry.enter(phase_graph);
+	const ConflictGraph& conflict_graph = instance.conflict_graph();
+	telemetry.enter(phase_seeding);
 
 	cerr << "Creating initial gene pool..." << endl;
 
 	vector<Gene> pool; pool.reserve(pool_size);
 
-	unordered_set<size_t> most_conflicting = removeMostConflicting(conflict_graph);
-	bits most_conflicting_ingredients = ingredients_from_client_set(most_conflicting, client_likes);
+	unordered_set<int> most_conflicting = removeMostConflictingBucketed(conflict_graph);
+	bits most_conflicting_ingredients = ingredients_from_client_set(most_conflicting, client_likes, num_ingredients);
 	const size_t most_conflicting_fitness = evaluate_fitness(most_conflicting_ingredients, client_likes, client_dislikes);
 	cerr << "Most conflicting heuristic: " << most_conflicting_fitness << endl;
 	pool.push_back(Gene(most_conflicting_ingredients, most_conflicting_fitness));
 
 
-	unordered_set<size_t> least_conflicting = addLeastConflicting(conflict_graph);
-	bits least_conflicting_ingredients = ingredients_from_client_set(least_conflicting, client_likes);
+	unordered_set<int> least_conflicting = addLeastConflictingBucketed(conflict_graph);
+	bits least_conflicting_ingredients = ingredients_from_client_set(least_conflicting, client_likes, num_ingredients);
 	const size_t least_conflicting_fitness = evaluate_fitness(least_conflicting_ingredients, client_likes, client_dislikes);
 	cerr << "Least conflicting heuristic: " << least_conflicting_fitness << endl;
 	pool.push_back(Gene(least_conflicting_ingredients, least_conflicting_fitness));
 
-	for (size_t i = 2; i < pool_size; ++i) {
+	for (const vector<int>& solution : load_initial_solutions(options, original)) {
+		if (pool.size() == pool_size) break;
+		bits initial_ingredients = ingredients_from_ids(reduction.compress(solution), num_ingredients);
+		const size_t initial_fitness = evaluate_fitness(initial_ingredients, client_likes, client_dislikes);
+		cerr << "Initial solution: " << initial_fitness << endl;
+		pool.push_back(Gene(std::move(initial_ingredients), initial_fitness));
+	}
+
+	while (pool.size() < pool_size) {
 		const bits ingredients = random_bitset(generator, num_ingredients);
 		const size_t fitness = evaluate_fitness(ingredients, client_likes, client_dislikes);
 		pool.push_back(Gene(ingredients, fitness));
@@ -188,43 +202,63 @@ int main() {
 
 	sort(pool.begin(), pool.end());
 
+	ThreadPool workers(num_threads);
+	vector<FitnessDelta> fitness_deltas;
+	vector<vector<int>> changes(workers.size());
+	for (size_t worker = 0; worker < workers.size(); ++worker) fitness_deltas.emplace_back(preferences);
+	vector<mt19937_64> stream_generators;
+	for (size_t stream = 0; stream < num_streams; ++stream) stream_generators.emplace_back(generator());
+	vector<Gene> new_pool(3 * pool_size);
+
 	evolution_started = true;
-	size_t generation = 0;
+	telemetry.enter(phase_search);
+	telemetry.improve(pool.back().fitness);
 
 	while (running) {
-		++generation;
-		cerr << "Generation: " << generation << ". Best fitness: " << pool.back().fitness << endl;
-		vector<Gene> new_pool; new_pool.reserve(3 * pool_size);
-		for (Gene gene : pool) {
-			new_pool.push_back(gene);
-			const bits random_ingredients_flipped = flip_random_bits(generator, gene.ingredients, num_ingredients);
-			new_pool.push_back(Gene(random_ingredients_flipped, evaluate_fitness(random_ingredients_flipped, client_likes, client_dislikes)));
-			const bits random_clients_satisfied = satisfy_random_clients(generator, gene.ingredients, client_likes, client_dislikes);
-			new_pool.push_back(Gene(random_clients_satisfied, evaluate_fitness(random_clients_satisfied, client_likes, client_dislikes)));
-		}
+		workers.run([&](size_t worker) {
+			FitnessDelta& fitness_delta = fitness_deltas[worker];
+			vector<int>& changed = changes[worker];
+			for (size_t stream = worker; stream < num_streams; stream += workers.size()) {
+				mt19937_64& stream_generator = stream_generators[stream];
+				for (size_t i = stream * pool_size / num_streams; i < (stream + 1) * pool_size / num_streams; ++i) {
+					const Gene& gene = pool[i];
+					new_pool[3 * i] = gene;
+					bits random_ingredients_flipped = flip_random_bits(stream_generator, gene.ingredients, num_ingredients, changed);
+					const size_t flipped_fitness = gene.fitness + fitness_delta(gene.ingredients, random_ingredients_flipped, changed);
+					new_pool[3 * i + 1] = Gene(std::move(random_ingredients_flipped), flipped_fitness);
+					bits random_clients_satisfied = satisfy_random_clients(stream_generator, gene.ingredients, preferences, changed);
+					const size_t satisfied_fitness = gene.fitness + fitness_delta(gene.ingredients, random_clients_satisfied, changed);
+					new_pool[3 * i + 2] = Gene(std::move(random_clients_satisfied), satisfied_fitness);
+				}
+			}
+		});
 		sort(new_pool.begin(), new_pool.end());
 		vector<Gene> filtered_pool; filtered_pool.reserve(3 * pool_size);
 		filtered_pool.push_back(new_pool.front());
-		for (Gene gene : new_pool) {
+		for (const Gene& gene : new_pool) {
 			if (gene.ingredients != filtered_pool.back().ingredients) {
 				filtered_pool.push_back(gene);
 			}
 		}
+		telemetry.add(evaluations, 2 * pool_size + pool_size - min<size_t>(filtered_pool.size(), pool_size));
 		while (filtered_pool.size() < pool_size) {
 			const bits ingredients = random_bitset(generator, num_ingredients);
 			filtered_pool.push_back(Gene(ingredients, evaluate_fitness(ingredients, client_likes, client_dislikes)));
 		}
 		sort(filtered_pool.begin(), filtered_pool.end());
 		pool = vector<Gene>(filtered_pool.end() - pool_size, filtered_pool.end());
+		telemetry.improve(pool.back().fitness);
+		if (control.checkpoint_due()) control.checkpoint(text(pool.back().ingredients));
+		control.tick();
 	}
 
 	cerr << "Writing best solution found..." << endl;
-	bits ingredients = pool.back().ingredients;
-	cout << ingredients.count();
-	for (size_t i = 0; i < num_ingredients; ++i) {
-		if (ingredients[i]) cout << " " << ingredient_names[i];
-	}
-	cout << endl;
+	telemetry.enter(phase_output);
+	control.report();
+	const string solution = text(pool.back().ingredients);
+	control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
 
 	return 0;
 }
\ No newline at end of file
@@ -1,10 +1,15 @@
 #include <algorithm>
-#include <bitset>
+#include "conflict_graph.h"
+#include "dynamic_bitset.h"
 #include "heuristics.h"
+#include "incremental_fitness.h"
+#include "input.h"
 #include <iostream>
+#include "options.h"
 #include <random>
+#include "run_control.h"
 #include <signal.h>
-#include <unordered_map>
+#include "telemetry.h"
 #include <unordered_set>
 #include <vector>
 
@@ -14,7 +19,6 @@ constexpr int pool_size = 1000;
 constexpr double bit_flip_probability = 0.5;
 constexpr double client_satisfaction_probability = 0.5;
 
-bool running = true;
 bool evolution_started = false;
 
 void sigint_handler(int sig) {
@@ -34,28 +38,23 @@ struct seed {
 	seed() : dev{} {}
 };
 
-typedef bitset<10000> bits;
+typedef DynamicBitSet bits;
 
 typedef struct Gene {
 	bits ingredients;
 	size_t fitness;
 	Gene(bits ingredients, size_t fitness) : ingredients(ingredients), fitness(fitness) {}
-	friend constexpr bool operator<(const Gene& a, const Gene& b) {
+	friend bool operator<(const Gene& a, const Gene& b) {
 		if (a.fitness != b.fitness) return a.fitness < b.fitness;
-		for (size_t i = 0; i < 10000; ++i) {
-			if (a.ingredients[i] != b.ingredients[i]) return a.ingredients[i] < b.ingredients[i];
-		}
-		return false;
+		return a.ingredients < b.ingredients;
 	}
 } Gene;
 
 const size_t evaluate_fitness(const bits& ingredients, const vector<bits>& client_likes, const vector<bits>& client_dislikes) {
 	size_t satisfied = 0;
 	for (size_t client = 0; client < client_likes.size(); ++client) {
-		if ((ingredients & client_likes[client]) == client_likes[client]) {
-			if ((ingredients & client_dislikes[client]).none()) {
-				++satisfied;
-			}
+		if (client_likes[client].is_subset_of(ingredients) && !client_dislikes[client].intersects(ingredients)) {
+			++satisfied;
 		}
 	}
 	return satisfied;
@@ -63,111 +62,108 @@ const size_t evaluate_fitness(const bits& ingredients, const vector<bits>& clien
 
 template <class Generator>
 const bits random_bitset(Generator& generator, size_t num_ingredients) {
-	bits result;
+	bits result(num_ingredients);
 	bernoulli_distribution dist(0.5);
 
 	for (size_t i = 0; i < num_ingredients; ++i) {
-		result[i] = dist(generator);
+		result.set(i, dist(generator));
 	}
 
 	return result;
 }
 
-const bits ingredients_from_client_set(const unordered_set<size_t>& clients, const vector<bits>& client_likes) {
-	bits ingredients;
-	for (size_t client: clients) {
+const bits ingredients_from_client_set(const unordered_set<int>& clients, const vector<bits>& client_likes, const size_t num_ingredients) {
+	bits ingredients(num_ingredients);
+	for (int client: clients) {
 		ingredients |= client_likes[client];
 	}
 	return ingredients;
 }
 
+const bits ingredients_from_ids(const vector<int>& ingredients, const size_t num_ingredients) {
+	bits result(num_ingredients);
+	for (int ingredient : ingredients) {
+		result.set(ingredient);
+	}
+	return result;
+}
+
 template <class Generator>
-const bits flip_random_bits(Generator& generator, const bits current_bits, const size_t num_ingredients) {
-	bits new_bits(current_bits);
+void flip_random_bits(Generator& generator, IncrementalFitness& fitness, const size_t num_ingredients) {
 	uniform_int_distribution<size_t> dist(0, num_ingredients - 1);
 	uniform_real_distribution<double> real_dist(0, 1);
 	do {
-		new_bits.flip(dist(generator));
+		fitness.flip(dist(generator));
 	} while (real_dist(generator) < bit_flip_probability);
-	return new_bits;
 }
 
 template <class Generator>
-const bits satisfy_random_clients(Generator& generator, const bits current_bits, const vector<bits>& client_likes, const vector<bits>& client_dislikes) {
-	uniform_int_distribution<size_t> dist(0, client_likes.size() - 1);
+void satisfy_random_clients(Generator& generator, IncrementalFitness& fitness, const Preferences& preferences) {
+	uniform_int_distribution<size_t> dist(0, preferences.num_clients() - 1);
 	uniform_real_distribution<double> real_dist(0, 1);
-	bits result = bits(current_bits);
 	do {
 		const size_t client_index = dist(generator);
-		result |= client_likes[client_index];
-		result &= (~client_dislikes[client_index]);
+		for (int ingredient : preferences.likes(client_index)) fitness.set(ingredient, true);
+		for (int ingredient : preferences.dislikes(client_index)) fitness.set(ingredient, false);
 	} while (real_dist(generator) < client_satisfaction_probability);
-	return result;
 }
 
-int main() {
+bool keep_or_rollback(IncrementalFitness& fitness, bits& best_so_far, size_t& best_fitness_so_far) {
+	if (fitness.fitness() > best_fitness_so_far) {
+		best_fitness_so_far = fitness.fitness();
+		for (int ingredient : fitness.changes()) best_so_far.flip(ingredient);
+		fitness.commit();
+		return true;
+	}
+	fitness.rollback();
+	return false;
+}
+
+int main(int argc, char** argv) {
+
+	const Options options(argc, argv);
+	RunControl control(options);
+	telemetry.start_sampling(options);
 
 	struct seed seeder;
 	mt19937_64 generator(seeder);
+	if (options.has("seed")) generator.seed(options.get_int("seed", 0));
 
 	signal(SIGINT, sigint_handler);
 
-	size_t num_clients; cin >> num_clients;
-
-	unordered_map<string, size_t> ingredient_ids;
-	vector<string> ingredient_names;
-	size_t num_ingredients = 0;
+	const Instance instance = load_instance(options);
+	const Preferences& preferences = instance.preferences;
+	const vector<string>& ingredient_names = instance.ingredient_names();
+	const size_t num_clients = instance.num_clients();
+	const size_t num_ingredients = instance.num_ingredients();
+	if (num_ingredients == 0) {
+		cout << solution_text(ingredient_names, bits(0));
+		telemetry.stop();
+		return 0;
+	}
 
 	vector<bits> client_likes;
 	client_likes.reserve(num_clients);
 	vector<bits> client_dislikes;
 	client_dislikes.reserve(num_clients);
-
-	for (int client = 0; client < num_clients; ++client) {
-		int num_likes; cin >> num_likes;
-		bits current_likes;
-		for (int i = 0; i < num_likes; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = num_ingredients++;
-				ingredient_names.push_back(name);
-			}
-			current_likes[ingredient_ids[name]] = true;
-		}
+	for (size_t client = 0; client < num_clients; ++client) {
+		bits current_likes(num_ingredients);
+		for (int ingredient : preferences.likes(client)) current_likes.set(ingredient);
 		client_likes.push_back(current_likes);
-
-		int num_dislikes; cin >> num_dislikes;
-		bits current_dislikes;
-		for (int i = 0; i < num_dislikes; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = num_ingredients++;
-				ingredient_names.push_back(name);
-			}
-			current_dislikes[ingredient_ids[name]] = true;
-		}
+		bits current_dislikes(num_ingredients);
+		for (int ingredient : preferences.dislikes(client)) current_dislikes.set(ingredient);
 		client_dislikes.push_back(current_dislikes);
 	}
 
-	vector<unordered_set<size_t>> conflict_graph;
-	conflict_graph.reserve(num_clients);
-	for (size_t i = 0; i < num_clients; ++i) conflict_graph.push_back(unordered_set<size_t>());
-
-	for (size_t i = 0; i < num_clients; ++i) {
-		for (size_t j = 0; j < num_clients; ++j) {
-			if (i == j) continue;
-			if (!(client_likes[i] & client_dislikes[j]).none()) {
-				conflict_graph[i].insert(j);
-				conflict_graph[j].insert(i);
-			}
-		}
-	}
+	telemetry.enter(phase_graph);
+	const ConflictGraph& conflict_graph = instance.conflict_graph();
+	telemetry.enter(phase_seeding);
 
-	bits best_so_far;
+	bits best_so_far(num_ingredients);
 	size_t best_fitness_so_far = evaluate_fitness(best_so_far, client_likes, client_dislikes);
 
-	unordered_set<size_t> most_conflicting = removeMostConflicting(conflict_graph);
-	bits most_conflicting_ingredients = ingredients_from_client_set(most_conflicting, client_likes);
+	unordered_set<int> most_conflicting = removeMostConflictingBucketed(conflict_graph);
+	bits most_conflicting_ingredients = ingredients_from_client_set(most_conflicting, client_likes, num_ingredients);
 	const size_t most_conflicting_fitness = evaluate_fitness(most_conflicting_ingredients, client_likes, client_dislikes);
 	cerr << "Most conflicting heuristic: " << most_conflicting_fitness << endl;
 	if (most_conflicting_fitness > best_fitness_so_far) {
@@ -175,8 +171,8 @@ int main() {
 		best_so_far = most_conflicting_ingredients;
 	}	
 
-	unordered_set<size_t> least_conflicting = addLeastConflicting(conflict_graph);
-	bits least_conflicting_ingredients = ingredients_from_client_set(least_conflicting, client_likes);
+	unordered_set<int> least_conflicting = addLeastConflictingBucketed(conflict_graph);
+	bits least_conflicting_ingredients = ingredients_from_client_set(least_conflicting, client_likes, num_ingredients);
 	const size_t least_conflicting_fitness = evaluate_fitness(least_conflicting_ingredients, client_likes, client_dislikes);
 	cerr << "Least conflicting heuristic: " << least_conflicting_fitness << endl;
 	if (least_conflicting_fitness > best_fitness_so_far) {
@@ -184,39 +180,52 @@ int main() {
 		best_so_far = least_conflicting_ingredients;
 	}
 
+	for (const vector<int>& solution : load_initial_solutions(options, instance)) {
+		bits initial_ingredients = ingredients_from_ids(solution, num_ingredients);
+		const size_t initial_fitness = evaluate_fitness(initial_ingredients, client_likes, client_dislikes);
+		cerr << "Initial solution: " << initial_fitness << endl;
+		if (initial_fitness > best_fitness_so_far) {
+			best_fitness_so_far = initial_fitness;
+			best_so_far = initial_ingredients;
+		}
+	}
+
+	IncrementalFitness fitness(preferences);
+	fitness.reset(best_so_far);
+
 	evolution_started = true;
+	telemetry.enter(phase_search);
+	telemetry.improve(best_fitness_so_far);
 	size_t generation = 0;
-	size_t epoch = 0;
+	size_t accepted = 0;
 
 	while (running) {
-		++generation;
-		if (generation == 1000) {
-			generation = 0;
-			++epoch;
-			cerr << "Epoch: " << epoch << ". Best fitness: " << best_fitness_so_far << endl;
-		}
-		
-		const bits random_ingredients_flipped = flip_random_bits(generator, best_so_far, num_ingredients);
-		const size_t random_ingredients_flipped_fitness = evaluate_fitness(random_ingredients_flipped, client_likes, client_dislikes);
-		if (random_ingredients_flipped_fitness > best_fitness_so_far) {
-			best_fitness_so_far = random_ingredients_flipped_fitness;
-			best_so_far = random_ingredients_flipped;
-		}
+		flip_random_bits(generator, fitness, num_ingredients);
+		accepted += keep_or_rollback(fitness, best_so_far, best_fitness_so_far);
+
+		satisfy_random_clients(generator, fitness, preferences);
+		accepted += keep_or_rollback(fitness, best_so_far, best_fitness_so_far);
 
-		const bits random_clients_satisfied = satisfy_random_clients(generator, best_so_far, client_likes, client_dislikes);
-		const size_t random_clients_satisfied_fitness = evaluate_fitness(random_clients_satisfied, client_likes, client_dislikes);
-		if (random_clients_satisfied_fitness > best_fitness_so_far) {
-			best_fitness_so_far = random_clients_satisfied_fitness;
-			best_so_far = random_clients_satisfied;
+		if (++generation == 1000) {
+			generation = 0;
+			telemetry.add(evaluations, 2000);
+			telemetry.add(accepted_moves, accepted);
+			telemetry.improve(best_fitness_so_far);
+			accepted = 0;
+			if (control.checkpoint_due()) control.checkpoint(solution_text(ingredient_names, best_so_far));
+			control.tick(1000);
 		}
 	}
+	control.tick(generation);
 
 	cerr << "Writing best solution found..." << endl;
-	cout << best_so_far.count();
-	for (size_t i = 0; i < num_ingredients; ++i) {
-		if (best_so_far[i]) cout << " " << ingredient_names[i];
-	}
-	cout << endl;
+	telemetry.improve(best_fitness_so_far);
+	telemetry.enter(phase_output);
+	control.report();
+	const string solution = solution_text(ingredient_names, best_so_far);
+	control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
 
 	return 0;
 }
\ No newline at end of file
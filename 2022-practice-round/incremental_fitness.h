@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include "preferences.h"
+#include <vector>
+
+class IncrementalFitness {
+	const Preferences& preferences;
+	std::vector<char> present;
+	std::vector<int> missing_likes;
+	std::vector<int> present_dislikes;
+	std::vector<int> trail;
+	size_t satisfied;
+
+	bool is_satisfied(int client) const {
+		return missing_likes[client] == 0 && present_dislikes[client] == 0;
+	}
+
+	void apply(int ingredient) {
+		const bool adding = !present[ingredient];
+		present[ingredient] = adding;
+		const int step = adding ? 1 : -1;
+		for (int client : preferences.liked_by(ingredient)) {
+			if (is_satisfied(client)) --satisfied;
+			missing_likes[client] -= step;
+			if (is_satisfied(client)) ++satisfied;
+		}
+		for (int client : preferences.disliked_by(ingredient)) {
+			if (is_satisfied(client)) --satisfied;
+			present_dislikes[client] += step;
+			if (is_satisfied(client)) ++satisfied;
+		}
+	}
+
+public:
+	IncrementalFitness(const Preferences& preferences) :
+		preferences(preferences),
+		present(preferences.num_ingredients, 0),
+		missing_likes(preferences.num_clients(), 0),
+		present_dislikes(preferences.num_clients(), 0),
+		satisfied(0) {}
+
+	template <class Bits>
+	void reset(const Bits& ingredients) {
+		trail.clear();
+		satisfied = 0;
+		for (size_t ingredient = 0; ingredient < preferences.num_ingredients; ++ingredient) {
+			present[ingredient] = ingredients[ingredient];
+		}
+		for (size_t client = 0; client < preferences.num_clients(); ++client) {
+			missing_likes[client] = 0;
+			present_dislikes[client] = 0;
+			for (int ingredient : preferences.likes(client)) {
+				if (!present[ingredient]) ++missing_likes[client];
+			}
+			for (int ingredient : preferences.dislikes(client)) {
+				if (present[ingredient]) ++present_dislikes[client];
+			}
+			if (is_satisfied(client)) ++satisfied;
+		}
+	}
+
+	size_t fitness() const { return satisfied; }
+	bool has(size_t ingredient) const { return present[ingredient]; }
+
+	void flip(int ingredient) {
+		trail.push_back(ingredient);
+		apply(ingredient);
+	}
+
+	void set(int ingredient, bool value) {
+		if (has(ingredient) != value) flip(ingredient);
+	}
+
+	const std::vector<int>& changes() const { return trail; }
+
+	void commit() { trail.clear(); }
+
+	void rollback() {
+		while (!trail.empty()) {
+			apply(trail.back());
+			trail.pop_back();
+		}
+	}
+};
+
+class FitnessDelta {
+	const Preferences& preferences;
+	std::vector<size_t> visited;
+	size_t stamp;
+
+public:
+	FitnessDelta(const Preferences& preferences) : preferences(preferences), visited(preferences.num_clients(), 0), stamp(0) {}
+
+	template <class Bits>
+	long long operator()(const Bits& before, const Bits& after, const std::vector<int>& changed) {
+		++stamp;
+		long long delta = 0;
+		auto visit = [&](int client) {
+			if (visited[client] == stamp) return;
+			visited[client] = stamp;
+			delta += (long long)preferences.satisfied(client, after) - (long long)preferences.satisfied(client, before);
+		};
+		for (int ingredient : changed) {
+			for (int client : preferences.liked_by(ingredient)) visit(client);
+			for (int client : preferences.disliked_by(ingredient)) visit(client);
+		}
+		return delta;
+	}
+};
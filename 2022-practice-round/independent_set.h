@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "conflict_graph.h"
+#include "dynamic_bitset.h"
+#include <vector>
+
+// Kernelization for maximum independent set. reduce() applies these until none
+// of them fires:
+//   degree 0, 1  take the vertex
+//   degree 2     take it if its neighbours are adjacent, otherwise fold it and
+//                its neighbours into one vertex
+//   domination   drop u if a neighbour v has N[v] inside N[u]
+//   twins        two degree 3 vertices with the same neighbours: take both if
+//                the neighbours share an edge, otherwise fold all five
+// Folded vertices get ids past the end of the original graph. unfold() turns an
+// independent set of the kernel into one of the original graph that is larger
+// by offset().
+class IndependentSetKernel {
+	typedef struct Fold {
+		int vertex;
+		std::vector<int> if_taken;
+		std::vector<int> otherwise;
+	} Fold;
+
+	const size_t num_original;
+	std::vector<std::vector<int>> adjacency;
+	std::vector<char> alive;
+	std::vector<char> taken;
+	std::vector<Fold> folds;
+	std::vector<int> queue;
+	std::vector<char> queued;
+	std::vector<int> marks;
+	int mark;
+	size_t num_taken;
+	size_t num_alive;
+
+	void push(int vertex) {
+		if (queued[vertex]) return;
+		queued[vertex] = 1;
+		queue.push_back(vertex);
+	}
+
+	void remove(int vertex) {
+		alive[vertex] = 0;
+		--num_alive;
+		for (int neighbour : adjacency[vertex]) {
+			std::vector<int>& row = adjacency[neighbour];
+			row.erase(std::lower_bound(row.begin(), row.end(), vertex));
+			push(neighbour);
+		}
+		adjacency[vertex].clear();
+	}
+
+	void take(int vertex) {
+		taken[vertex] = 1;
+		++num_taken;
+		const std::vector<int> neighbours = adjacency[vertex];
+		remove(vertex);
+		for (int neighbour : neighbours) remove(neighbour);
+	}
+
+	int add_vertex(std::vector<int> neighbours) {
+		const int vertex = adjacency.size();
+		for (int neighbour : neighbours) {
+			adjacency[neighbour].push_back(vertex);
+			push(neighbour);
+		}
+		adjacency.push_back(std::move(neighbours));
+		alive.push_back(1);
+		taken.push_back(0);
+		queued.push_back(0);
+		marks.push_back(0);
+		++num_alive;
+		push(vertex);
+		return vertex;
+	}
+
+	// Replaces removed with a single vertex adjacent to everything that was
+	// adjacent to one of merged.
+	void fold(const std::vector<int>& removed, const std::vector<int>& merged) {
+		++mark;
+		for (int vertex : removed) marks[vertex] = mark;
+		std::vector<int> neighbours;
+		for (int vertex : merged) {
+			for (int neighbour : adjacency[vertex]) {
+				if (marks[neighbour] == mark) continue;
+				marks[neighbour] = mark;
+				neighbours.push_back(neighbour);
+			}
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		for (int vertex : removed) remove(vertex);
+		Fold record;
+		record.if_taken = merged;
+		for (int vertex : removed) {
+			if (std::find(merged.begin(), merged.end(), vertex) == merged.end()) record.otherwise.push_back(vertex);
+		}
+		record.vertex = add_vertex(std::move(neighbours));
+		folds.push_back(std::move(record));
+	}
+
+	bool adjacent(int a, int b) const {
+		const std::vector<int>& row = adjacency[a];
+		return std::binary_search(row.begin(), row.end(), b);
+	}
+
+	// Drops one neighbour of vertex whose closed neighbourhood contains
+	// vertex's, if there is one.
+	bool remove_dominated(int vertex) {
+		const std::vector<int>& row = adjacency[vertex];
+		++mark;
+		marks[vertex] = mark;
+		for (int neighbour : row) marks[neighbour] = mark;
+		for (int neighbour : row) {
+			if (adjacency[neighbour].size() < row.size()) continue;
+			size_t shared = 0;
+			for (int other : adjacency[neighbour]) shared += marks[other] == mark;
+			if (shared == row.size()) {
+				remove(neighbour);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool reduce_twin(int vertex) {
+		const std::vector<int>& row = adjacency[vertex];
+		for (int twin : adjacency[row[0]]) {
+			if (twin == vertex || adjacency[twin] != row) continue;
+			const std::vector<int> neighbours = row;
+			if (adjacent(neighbours[0], neighbours[1]) || adjacent(neighbours[0], neighbours[2]) || adjacent(neighbours[1], neighbours[2])) {
+				take(vertex);
+				take(twin);
+			}
+			else {
+				fold({vertex, twin, neighbours[0], neighbours[1], neighbours[2]}, neighbours);
+			}
+			return true;
+		}
+		return false;
+	}
+
+public:
+	IndependentSetKernel(const ConflictGraph& graph) :
+		num_original(graph.size()),
+		alive(graph.size(), 1),
+		taken(graph.size(), 0),
+		queued(graph.size(), 0),
+		marks(graph.size(), 0),
+		mark(0),
+		num_taken(0),
+		num_alive(graph.size()) {
+		adjacency.reserve(graph.size());
+		for (size_t vertex = 0; vertex < graph.size(); ++vertex) {
+			const IdRange neighbours = graph[vertex];
+			adjacency.emplace_back(neighbours.begin(), neighbours.end());
+		}
+	}
+
+	void reduce() {
+		for (size_t vertex = adjacency.size(); vertex-- > 0;) {
+			if (alive[vertex]) push(vertex);
+		}
+		while (!queue.empty()) {
+			const int vertex = queue.back();
+			queue.pop_back();
+			queued[vertex] = 0;
+			if (!alive[vertex]) continue;
+			const std::vector<int>& row = adjacency[vertex];
+			if (row.size() <= 1) {
+				take(vertex);
+			}
+			else if (row.size() == 2) {
+				if (adjacent(row[0], row[1])) take(vertex);
+				else fold({vertex, row[0], row[1]}, {row[0], row[1]});
+			}
+			else if (!remove_dominated(vertex) && row.size() == 3) {
+				reduce_twin(vertex);
+			}
+		}
+	}
+
+	size_t size() const { return num_alive; }
+	size_t num_folds() const { return folds.size(); }
+	bool contains(int vertex) const { return alive[vertex]; }
+	const std::vector<int>& neighbours(int vertex) const { return adjacency[vertex]; }
+
+	size_t offset() const {
+		size_t total = num_taken;
+		for (const Fold& record : folds) total += record.otherwise.size();
+		return total;
+	}
+
+	// Connected components of the kernel, largest first.
+	std::vector<std::vector<int>> components() const {
+		std::vector<std::vector<int>> result;
+		std::vector<char> seen(adjacency.size(), 0);
+		for (size_t start = 0; start < adjacency.size(); ++start) {
+			if (!alive[start] || seen[start]) continue;
+			std::vector<int> component(1, start);
+			seen[start] = 1;
+			for (size_t i = 0; i < component.size(); ++i) {
+				for (int neighbour : adjacency[component[i]]) {
+					if (seen[neighbour]) continue;
+					seen[neighbour] = 1;
+					component.push_back(neighbour);
+				}
+			}
+			result.push_back(std::move(component));
+		}
+		std::stable_sort(result.begin(), result.end(), [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() > b.size(); });
+		return result;
+	}
+
+	// Maps an independent set of the kernel to one of the original graph.
+	std::vector<int> unfold(const std::vector<int>& kernel_solution) const {
+		std::vector<char> chosen(taken);
+		for (int vertex : kernel_solution) chosen[vertex] = 1;
+		for (auto record = folds.rbegin(); record != folds.rend(); ++record) {
+			const bool folded_taken = chosen[record->vertex];
+			chosen[record->vertex] = 0;
+			for (int vertex : folded_taken ? record->if_taken : record->otherwise) chosen[vertex] = 1;
+		}
+		std::vector<int> solution;
+		for (size_t vertex = 0; vertex < num_original; ++vertex) {
+			if (chosen[vertex]) solution.push_back(vertex);
+		}
+		return solution;
+	}
+};
+
+// Exact branch and bound for maximum independent set on one component of a
+// kernel. This is the bitset max clique search run on the complement: the
+// candidates are greedily partitioned into cliques, an independent set takes
+// at most one vertex from each, and vertices are branched on from the last
+// clique backwards so that each branch only has to beat the cliques before it.
+class CliqueCoverSearch {
+	const std::vector<int> vertices;
+	const size_t num_words;
+	BitSetArena adjacency;
+	BitSetArena candidates;
+	BitSetArena scratch;
+	std::vector<std::vector<int>> orders;
+	std::vector<std::vector<int>> bounds;
+	std::vector<int> current;
+	std::vector<int> best;
+	size_t root_bound;
+	uint64_t nodes;
+	uint64_t pruned;
+
+	static int first_bit(const uint64_t* words, size_t num_words) {
+		for (size_t i = 0; i < num_words; ++i) {
+			if (words[i] != 0) return i * 64 + __builtin_ctzll(words[i]);
+		}
+		return -1;
+	}
+
+	static std::vector<int> by_degree(const IndependentSetKernel& kernel, std::vector<int> component) {
+		std::stable_sort(component.begin(), component.end(), [&](int a, int b) { return kernel.neighbours(a).size() > kernel.neighbours(b).size(); });
+		return component;
+	}
+
+	static void reset_bit(uint64_t* words, int bit) { words[bit >> 6] &= ~(uint64_t(1) << (bit & 63)); }
+
+	// Fills orders[depth] with the candidates that could still improve on best,
+	// and bounds[depth] with how many more vertices each one's branch can take.
+	// Returns the number of cliques.
+	size_t cover(size_t depth) {
+		std::vector<int>& order = orders[depth];
+		std::vector<int>& bound = bounds[depth];
+		order.clear();
+		bound.clear();
+		uint64_t* uncovered = scratch[0];
+		uint64_t* clique = scratch[1];
+		std::copy(candidates[depth], candidates[depth] + num_words, uncovered);
+		const int needed = int(best.size()) - int(current.size());
+		size_t cliques = 0;
+		for (int first = first_bit(uncovered, num_words); first >= 0; first = first_bit(uncovered, num_words)) {
+			++cliques;
+			std::copy(uncovered, uncovered + num_words, clique);
+			for (int vertex = first; vertex >= 0; vertex = first_bit(clique, num_words)) {
+				reset_bit(uncovered, vertex);
+				reset_bit(clique, vertex);
+				const uint64_t* row = adjacency[vertex];
+				for (size_t i = vertex >> 6; i < num_words; ++i) clique[i] &= row[i];
+				if (int(cliques) > needed) {
+					order.push_back(vertex);
+					bound.push_back(cliques);
+				}
+			}
+		}
+		return cliques;
+	}
+
+	template <class Improve, class Progress>
+	void expand(size_t depth, const std::atomic<bool>& running, Improve& improve, Progress& progress) {
+		cover(depth);
+		const std::vector<int>& order = orders[depth];
+		const std::vector<int>& bound = bounds[depth];
+		uint64_t* remaining = candidates[depth];
+		uint64_t* next = candidates[depth + 1];
+		for (size_t i = order.size(); i-- > 0;) {
+			if (current.size() + bound[i] <= best.size()) {
+				++pruned;
+				return;
+			}
+			if (!running.load(std::memory_order_relaxed)) return;
+			if (++nodes == 1024) {
+				progress(nodes, pruned);
+				nodes = pruned = 0;
+			}
+			const int vertex = order[i];
+			const uint64_t* row = adjacency[vertex];
+			for (size_t w = 0; w < num_words; ++w) next[w] = remaining[w] & ~row[w];
+			reset_bit(next, vertex);
+			current.push_back(vertex);
+			if (first_bit(next, num_words) < 0) {
+				if (current.size() > best.size()) {
+					best = current;
+					improve(solution());
+				}
+			}
+			else {
+				expand(depth + 1, running, improve, progress);
+			}
+			current.pop_back();
+			reset_bit(remaining, vertex);
+		}
+	}
+
+public:
+	// Vertices are relabelled in order of decreasing degree, so that the
+	// cliques grow from the highest degree vertices and branching starts from
+	// the lowest, as a min-degree greedy would.
+	CliqueCoverSearch(const IndependentSetKernel& kernel, std::vector<int> component) :
+		vertices(by_degree(kernel, std::move(component))),
+		num_words(bitset_words_for(vertices.size())),
+		adjacency(vertices.size(), vertices.size()),
+		candidates(vertices.size() + 1, vertices.size()),
+		scratch(2, vertices.size()),
+		orders(vertices.size() + 1),
+		bounds(vertices.size() + 1),
+		root_bound(vertices.size()),
+		nodes(0),
+		pruned(0) {
+		int max_vertex = 0;
+		for (int vertex : vertices) max_vertex = std::max(max_vertex, vertex);
+		std::vector<int> index(max_vertex + 1, -1);
+		for (size_t i = 0; i < vertices.size(); ++i) index[vertices[i]] = i;
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			uint64_t* row = adjacency[i];
+			for (int neighbour : kernel.neighbours(vertices[i])) {
+				const int j = index[neighbour];
+				row[j >> 6] |= uint64_t(1) << (j & 63);
+			}
+		}
+	}
+
+	size_t size() const { return vertices.size(); }
+	size_t upper_bound() const { return root_bound; }
+
+	// The best independent set found so far, in kernel ids.
+	std::vector<int> solution() const {
+		std::vector<int> result;
+		for (int vertex : best) result.push_back(vertices[vertex]);
+		return result;
+	}
+
+	// Searches until the component is solved or running is cleared. improve is
+	// called with each better solution; progress with node and prune counts in
+	// batches. Returns whether the solution is proven optimal.
+	template <class Improve, class Progress>
+	bool solve(const std::atomic<bool>& running, Improve improve, Progress progress) {
+		uint64_t* all = candidates[0];
+		for (size_t i = 0; i < vertices.size(); ++i) all[i >> 6] |= uint64_t(1) << (i & 63);
+		root_bound = cover(0);
+		expand(0, running, improve, progress);
+		progress(nodes, pruned);
+		nodes = pruned = 0;
+		const bool complete = running.load(std::memory_order_relaxed);
+		if (complete) root_bound = best.size();
+		return complete;
+	}
+};
+
+// Reduces graph and searches each component of the kernel in turn. The result
+// is maximum unless running is cleared first.
+std::vector<int> maximum_independent_set(const ConflictGraph& graph, const std::atomic<bool>& running) {
+	IndependentSetKernel kernel(graph);
+	kernel.reduce();
+	std::vector<int> solution;
+	for (std::vector<int>& component : kernel.components()) {
+		CliqueCoverSearch search(kernel, std::move(component));
+		search.solve(running, [](const std::vector<int>&) {}, [](uint64_t, uint64_t) {});
+		const std::vector<int> part = search.solution();
+		solution.insert(solution.end(), part.begin(), part.end());
+	}
+	return kernel.unfold(solution);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include "input.h"
+#include <map>
+#include "preferences.h"
+#include <utility>
+#include <vector>
+
+// Shrinks the ingredient space without changing the best score. An ingredient
+// nobody dislikes is always on and one nobody likes is always off, so neither
+// needs a variable. Ingredients liked and disliked by exactly the same clients
+// only ever satisfy someone when they agree, so they share a variable.
+//
+// instance has the same clients as the original, with one ingredient per
+// variable, named after the first ingredient it stands for. expand() turns
+// variable bits back into original ingredients and compress() goes the other
+// way.
+typedef struct IngredientReduction {
+	static constexpr int fixed_off = -1;
+	static constexpr int fixed_on = -2;
+
+	Instance instance;
+	std::vector<int> variable_of;
+	size_t num_fixed_on;
+	size_t num_fixed_off;
+
+	template <class Bits>
+	std::vector<char> expand(const Bits& bits) const {
+		std::vector<char> ingredients(variable_of.size(), 0);
+		for (size_t ingredient = 0; ingredient < variable_of.size(); ++ingredient) {
+			const int variable = variable_of[ingredient];
+			ingredients[ingredient] = variable == fixed_on || (variable >= 0 && bits[variable]);
+		}
+		return ingredients;
+	}
+
+	// A variable is on if any of its ingredients is.
+	std::vector<int> compress(const std::vector<int>& ingredients) const {
+		std::vector<int> variables;
+		for (int ingredient : ingredients) {
+			if (variable_of[ingredient] >= 0) variables.push_back(variable_of[ingredient]);
+		}
+		std::sort(variables.begin(), variables.end());
+		variables.erase(std::unique(variables.begin(), variables.end()), variables.end());
+		return variables;
+	}
+} IngredientReduction;
+
+IngredientReduction reduce_ingredients(const Instance& original) {
+	const Preferences& preferences = original.preferences;
+	const size_t num_ingredients = original.num_ingredients();
+	std::vector<int> variable_of(num_ingredients);
+	std::map<std::pair<std::vector<int>, std::vector<int>>, int> variables;
+	IngredientTable names;
+	size_t num_fixed_on = 0, num_fixed_off = 0;
+	for (size_t ingredient = 0; ingredient < num_ingredients; ++ingredient) {
+		const IdRange likers = preferences.liked_by(ingredient);
+		const IdRange dislikers = preferences.disliked_by(ingredient);
+		if (dislikers.empty()) {
+			variable_of[ingredient] = IngredientReduction::fixed_on;
+			++num_fixed_on;
+			continue;
+		}
+		if (likers.empty()) {
+			variable_of[ingredient] = IngredientReduction::fixed_off;
+			++num_fixed_off;
+			continue;
+		}
+		auto signature = std::make_pair(std::vector<int>(likers.begin(), likers.end()), std::vector<int>(dislikers.begin(), dislikers.end()));
+		auto found = variables.emplace(std::move(signature), names.size());
+		if (found.second) names.intern(original.ingredient_names()[ingredient]);
+		variable_of[ingredient] = found.first->second;
+	}
+
+	std::vector<size_t> like_offsets(1, 0), dislike_offsets(1, 0);
+	std::vector<int> like_ids, dislike_ids;
+	for (size_t client = 0; client < original.num_clients(); ++client) {
+		for (int ingredient : preferences.likes(client)) {
+			if (variable_of[ingredient] >= 0) like_ids.push_back(variable_of[ingredient]);
+		}
+		like_offsets.push_back(like_ids.size());
+		for (int ingredient : preferences.dislikes(client)) {
+			if (variable_of[ingredient] >= 0) dislike_ids.push_back(variable_of[ingredient]);
+		}
+		dislike_offsets.push_back(dislike_ids.size());
+	}
+	const size_t num_variables = names.size();
+	return IngredientReduction{
+		Instance(std::move(names), Preferences(num_variables, std::move(like_offsets), std::move(like_ids), std::move(dislike_offsets), std::move(dislike_ids))),
+		std::move(variable_of),
+		num_fixed_on,
+		num_fixed_off
+	};
+}
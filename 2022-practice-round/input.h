@@ -0,0 +1,437 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "conflict_graph.h"
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include "options.h"
+#include "preferences.h"
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Read-only view of a whole input. Regular files (including a redirected
+// stdin) are memory-mapped; pipes are read into a buffer.
+class InputBuffer {
+	const char* mapped;
+	size_t mapped_size;
+	std::string buffer;
+
+public:
+	InputBuffer(int fd) : mapped(nullptr), mapped_size(0) {
+		struct stat info;
+		if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+			void* memory = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (memory != MAP_FAILED) {
+				madvise(memory, info.st_size, MADV_SEQUENTIAL);
+				mapped = static_cast<const char*>(memory);
+				mapped_size = info.st_size;
+				return;
+			}
+		}
+		char chunk[1 << 16];
+		ssize_t count;
+		while ((count = read(fd, chunk, sizeof(chunk))) > 0) buffer.append(chunk, count);
+	}
+
+	InputBuffer(std::string text) : mapped(nullptr), mapped_size(0), buffer(std::move(text)) {}
+
+	InputBuffer(const InputBuffer&) = delete;
+	InputBuffer& operator=(const InputBuffer&) = delete;
+
+	~InputBuffer() {
+		if (mapped != nullptr) munmap(const_cast<char*>(mapped), mapped_size);
+	}
+
+	std::string_view contents() const {
+		return mapped != nullptr ? std::string_view(mapped, mapped_size) : std::string_view(buffer);
+	}
+};
+
+class Tokenizer {
+	const char* position;
+	const char* end;
+
+	static bool is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+public:
+	Tokenizer(std::string_view text) : position(text.data()), end(text.data() + text.size()) {}
+
+	std::string_view next() {
+		while (position < end && is_space(*position)) ++position;
+		const char* start = position;
+		while (position < end && !is_space(*position)) ++position;
+		return std::string_view(start, position - start);
+	}
+
+	size_t next_number() {
+		const std::string_view token = next();
+		size_t value = 0;
+		for (char c : token) value = value * 10 + (c - '0');
+		return value;
+	}
+};
+
+// Open-addressing map from ingredient name to dense id. Slots hold ids into
+// names, so a probe compares against the stored name only on a hash match.
+class IngredientTable {
+	std::vector<int> slots;
+	std::vector<uint64_t> hashes;
+	size_t mask;
+
+	static uint64_t hash(std::string_view name) {
+		uint64_t value = 14695981039346656037ULL;
+		for (unsigned char c : name) {
+			value ^= c;
+			value *= 1099511628211ULL;
+		}
+		return value;
+	}
+
+	void grow() {
+		std::vector<int> old_slots(slots.size() * 2, -1);
+		old_slots.swap(slots);
+		mask = slots.size() - 1;
+		for (int id : old_slots) {
+			if (id < 0) continue;
+			size_t slot = hashes[id] & mask;
+			while (slots[slot] >= 0) slot = (slot + 1) & mask;
+			slots[slot] = id;
+		}
+	}
+
+public:
+	std::vector<std::string> names;
+
+	IngredientTable() : slots(1024, -1), mask(1023) {}
+
+	int find(std::string_view name) const {
+		const uint64_t key = hash(name);
+		for (size_t slot = key & mask; slots[slot] >= 0; slot = (slot + 1) & mask) {
+			const int id = slots[slot];
+			if (hashes[id] == key && names[id] == name) return id;
+		}
+		return -1;
+	}
+
+	int intern(std::string_view name) {
+		const uint64_t key = hash(name);
+		size_t slot = key & mask;
+		for (; slots[slot] >= 0; slot = (slot + 1) & mask) {
+			const int id = slots[slot];
+			if (hashes[id] == key && names[id] == name) return id;
+		}
+		const int id = names.size();
+		slots[slot] = id;
+		hashes.push_back(key);
+		names.emplace_back(name);
+		if (2 * names.size() > slots.size()) grow();
+		return id;
+	}
+
+	size_t size() const { return names.size(); }
+};
+
+struct Instance {
+	IngredientTable ingredients;
+	Preferences preferences;
+	mutable ConflictGraph graph;
+	mutable bool has_graph;
+
+	Instance(IngredientTable ingredients, Preferences preferences) : ingredients(std::move(ingredients)), preferences(std::move(preferences)), has_graph(false) {}
+
+	Instance(IngredientTable ingredients, Preferences preferences, ConflictGraph graph) : ingredients(std::move(ingredients)), preferences(std::move(preferences)), graph(std::move(graph)), has_graph(true) {}
+
+	const std::vector<std::string>& ingredient_names() const { return ingredients.names; }
+	size_t num_clients() const { return preferences.num_clients(); }
+	size_t num_ingredients() const { return preferences.num_ingredients; }
+
+	// Taken from the cache when there is one, otherwise built on first use.
+	const ConflictGraph& conflict_graph() const {
+		if (!has_graph) {
+			graph = build_conflict_graph(preferences);
+			has_graph = true;
+		}
+		return graph;
+	}
+};
+
+Instance parse_instance(std::string_view text) {
+	Tokenizer tokens(text);
+	IngredientTable ingredients;
+	const size_t num_clients = tokens.next_number();
+	std::vector<size_t> like_offsets(1, 0), dislike_offsets(1, 0);
+	std::vector<int> like_ids, dislike_ids;
+	like_offsets.reserve(num_clients + 1);
+	dislike_offsets.reserve(num_clients + 1);
+	for (size_t client = 0; client < num_clients; ++client) {
+		const size_t num_likes = tokens.next_number();
+		for (size_t i = 0; i < num_likes; ++i) like_ids.push_back(ingredients.intern(tokens.next()));
+		like_offsets.push_back(like_ids.size());
+		const size_t num_dislikes = tokens.next_number();
+		for (size_t i = 0; i < num_dislikes; ++i) dislike_ids.push_back(ingredients.intern(tokens.next()));
+		dislike_offsets.push_back(dislike_ids.size());
+	}
+	const size_t num_ingredients = ingredients.size();
+	return Instance(std::move(ingredients), Preferences(num_ingredients, std::move(like_offsets), std::move(like_ids), std::move(dislike_offsets), std::move(dislike_ids)));
+}
+
+// Binary cache layout: a CacheHeader followed by a payload of 8-byte aligned
+// sections, each a uint64 element count and the elements. The sections are the
+// path of the text input the cache was built from, the ingredient name offsets
+// and characters, and the offsets and ids of the likes, dislikes, liked-by,
+// disliked-by and conflict graph CSR arrays. The checksum covers the whole
+// payload. The CSR arrays are used in place, straight from the mapped file.
+constexpr char cache_magic[8] = {'P', 'Z', 'C', 'A', 'C', 'H', 'E', '\0'};
+constexpr uint32_t cache_version = 2;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t payload_size;
+	uint64_t checksum;
+	uint64_t source_size;
+	int64_t source_mtime;
+};
+
+uint64_t cache_checksum(const char* data, size_t size) {
+	uint64_t value = 14695981039346656037ULL;
+	for (size_t i = 0; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		value = (value ^ word) * 1099511628211ULL;
+		value ^= value >> 29;
+	}
+	return value;
+}
+
+// Size and modification time in nanoseconds of the file at path.
+bool file_stamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return false;
+	size = info.st_size;
+	mtime = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+	return true;
+}
+
+bool is_cache(std::string_view text) {
+	return text.size() >= sizeof(CacheHeader) && std::memcmp(text.data(), cache_magic, sizeof(cache_magic)) == 0;
+}
+
+template <class T>
+void put_section(std::string& payload, const T* items, size_t count) {
+	const uint64_t header = count;
+	payload.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	payload.append(reinterpret_cast<const char*>(items), count * sizeof(T));
+	payload.resize((payload.size() + 7) / 8 * 8, '\0');
+}
+
+template <class T>
+void put_section(std::string& payload, const std::vector<T>& items) {
+	put_section(payload, items.data(), items.size());
+}
+
+void put_lists(std::string& payload, const CsrArray& lists) {
+	put_section(payload, lists.offsets, lists.size() + 1);
+	put_section(payload, lists.ids, lists.num_ids());
+}
+
+// source is the text input the instance was read from, or "-" for stdin, in
+// which case the cache is not tied to a file.
+std::string encode_cache(const Instance& instance, const std::string& source) {
+	CacheHeader header;
+	std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.reserved = 0;
+	header.source_size = 0;
+	header.source_mtime = 0;
+	std::string source_path;
+	if (source != "-") {
+		char* resolved = realpath(source.c_str(), nullptr);
+		if (resolved != nullptr && file_stamp(resolved, header.source_size, header.source_mtime)) source_path = resolved;
+		free(resolved);
+	}
+
+	std::vector<uint64_t> name_offsets(1, 0);
+	std::string name_chars;
+	for (const std::string& name : instance.ingredient_names()) {
+		name_chars += name;
+		name_offsets.push_back(name_chars.size());
+	}
+	const Preferences& preferences = instance.preferences;
+	std::string payload;
+	put_section(payload, source_path.data(), source_path.size());
+	put_section(payload, name_offsets);
+	put_section(payload, name_chars.data(), name_chars.size());
+	put_lists(payload, preferences.like_lists);
+	put_lists(payload, preferences.dislike_lists);
+	put_lists(payload, preferences.liked_by_lists);
+	put_lists(payload, preferences.disliked_by_lists);
+	put_lists(payload, instance.conflict_graph().adjacency);
+
+	header.payload_size = payload.size();
+	header.checksum = cache_checksum(payload.data(), payload.size());
+	return std::string(reinterpret_cast<const char*>(&header), sizeof(header)) + payload;
+}
+
+void malformed_cache() {
+	std::cerr << "Malformed cache section; rebuild it with make_cache" << std::endl;
+	exit(1);
+}
+
+// Rejects a cache whose text input has changed since it was built. A cache
+// whose input has gone is still used.
+void check_cache_source(const std::string& source, const CacheHeader& header) {
+	uint64_t size;
+	int64_t mtime;
+	if (!file_stamp(source, size, mtime)) {
+		std::cerr << "Cache source " << source << " is missing; using the cache as it is" << std::endl;
+	}
+	else if (size != header.source_size || mtime != header.source_mtime) {
+		std::cerr << source << " has changed since the cache was built; rebuild it with make_cache" << std::endl;
+		exit(1);
+	}
+}
+
+class CacheReader {
+	const char* position;
+	const char* end;
+
+public:
+	CacheReader(const char* data, size_t size) : position(data), end(data + size) {}
+
+	// A view of the next section, which stays in the cache.
+	template <class T>
+	const T* section(size_t& count) {
+		uint64_t header = 0;
+		if (end - position >= 8) std::memcpy(&header, position, 8);
+		if (end - position < 8 || header > size_t(end - position - 8) / sizeof(T)) malformed_cache();
+		const T* items = reinterpret_cast<const T*>(position + 8);
+		count = header;
+		position += 8 + (count * sizeof(T) + 7) / 8 * 8;
+		return items;
+	}
+
+	std::string_view text() {
+		size_t count;
+		const char* chars = section<char>(count);
+		return std::string_view(chars, count);
+	}
+
+	// Lists of ids below num_columns, checked so that no range can leave the
+	// cache.
+	CsrArray lists(const std::shared_ptr<const void>& storage, size_t num_columns) {
+		size_t num_offsets, num_ids;
+		const size_t* offsets = section<size_t>(num_offsets);
+		const int* ids = section<int>(num_ids);
+		if (num_offsets == 0 || offsets[0] != 0 || offsets[num_offsets - 1] != num_ids) malformed_cache();
+		for (size_t row = 0; row + 1 < num_offsets; ++row) {
+			if (offsets[row] > offsets[row + 1]) malformed_cache();
+		}
+		for (size_t i = 0; i < num_ids; ++i) {
+			if (ids[i] < 0 || size_t(ids[i]) >= num_columns) malformed_cache();
+		}
+		return CsrArray(storage, offsets, ids, num_offsets - 1);
+	}
+};
+
+// The CSR arrays of the instance point into input, which they keep alive.
+Instance decode_cache(const std::shared_ptr<const InputBuffer>& input) {
+	const std::string_view text = input->contents();
+	CacheHeader header;
+	std::memcpy(&header, text.data(), sizeof(header));
+	const char* payload = text.data() + sizeof(header);
+	if (header.version != cache_version) {
+		std::cerr << "Cache version " << header.version << " is stale (expected " << cache_version << "); rebuild it with make_cache" << std::endl;
+		exit(1);
+	}
+	if (header.payload_size != text.size() - sizeof(header) || header.checksum != cache_checksum(payload, header.payload_size)) {
+		std::cerr << "Cache checksum mismatch; rebuild it with make_cache" << std::endl;
+		exit(1);
+	}
+	CacheReader reader(payload, header.payload_size);
+	const std::string source(reader.text());
+	if (!source.empty()) check_cache_source(source, header);
+
+	size_t num_names, num_chars;
+	const uint64_t* name_offsets = reader.section<uint64_t>(num_names);
+	const char* name_chars = reader.section<char>(num_chars);
+	IngredientTable ingredients;
+	for (size_t i = 0; i + 1 < num_names; ++i) {
+		if (name_offsets[i] > name_offsets[i + 1] || name_offsets[i + 1] > num_chars) malformed_cache();
+		ingredients.intern(std::string_view(name_chars + name_offsets[i], name_offsets[i + 1] - name_offsets[i]));
+	}
+	const size_t num_ingredients = ingredients.size();
+	CsrArray like_lists = reader.lists(input, num_ingredients);
+	const size_t num_clients = like_lists.size();
+	CsrArray dislike_lists = reader.lists(input, num_ingredients);
+	CsrArray liked_by_lists = reader.lists(input, num_clients);
+	CsrArray disliked_by_lists = reader.lists(input, num_clients);
+	CsrArray adjacency = reader.lists(input, num_clients);
+	if (dislike_lists.size() != num_clients || liked_by_lists.size() != num_ingredients || disliked_by_lists.size() != num_ingredients || adjacency.size() != num_clients) malformed_cache();
+	Preferences preferences(num_ingredients, std::move(like_lists), std::move(dislike_lists), std::move(liked_by_lists), std::move(disliked_by_lists));
+	return Instance(std::move(ingredients), std::move(preferences), ConflictGraph(std::move(adjacency)));
+}
+
+Instance read_instance(const std::shared_ptr<const InputBuffer>& input) {
+	return is_cache(input->contents()) ? decode_cache(input) : parse_instance(input->contents());
+}
+
+// The input is the first positional argument (or --input); without one it is
+// read from stdin. Either a text instance or a cache written by make_cache.
+std::string input_path(const Options& options) {
+	if (options.has("input")) return options.get("input");
+	if (!options.positional.empty()) return options.positional[0];
+	return "-";
+}
+
+Instance load_instance(const Options& options) {
+	const std::string path = input_path(options);
+	if (path == "-") return read_instance(std::make_shared<const InputBuffer>(STDIN_FILENO));
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Could not open " << path << std::endl;
+		exit(1);
+	}
+	const std::shared_ptr<const InputBuffer> input = std::make_shared<const InputBuffer>(fd);
+	close(fd);
+	return read_instance(input);
+}
+
+// Ingredient ids of a solution written by one of the solvers. Names that are
+// not in the instance are reported and skipped.
+std::vector<int> load_solution(const Instance& instance, const std::string& path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Could not open " << path << std::endl;
+		exit(1);
+	}
+	InputBuffer input(fd);
+	close(fd);
+	Tokenizer tokens(input.contents());
+	const size_t count = tokens.next_number();
+	std::vector<int> ingredients;
+	ingredients.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		const std::string_view name = tokens.next();
+		const int id = instance.ingredients.find(name);
+		if (id < 0) std::cerr << "Ignoring unknown ingredient " << name << " in " << path << std::endl;
+		else ingredients.push_back(id);
+	}
+	return ingredients;
+}
+
+// One solution per --init option, in the order given.
+std::vector<std::vector<int>> load_initial_solutions(const Options& options, const Instance& instance) {
+	std::vector<std::vector<int>> solutions;
+	for (const std::string& path : options.get_all("init")) solutions.push_back(load_solution(instance, path));
+	return solutions;
+}
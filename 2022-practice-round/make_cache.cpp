@@ -0,0 +1,40 @@
+#include <cstdio>
+#include <fstream>
+#include "input.h"
+#include <iostream>
+#include "options.h"
+
+using namespace std;
+
+// Usage: make_cache <input> <output>, or --input/--output. The output can be
+// passed to any of the solvers in place of the text input.
+int main(int argc, char** argv) {
+
+	const Options options(argc, argv);
+	const string output = options.has("output") ? options.get("output") : options.positional.size() > 1 ? options.positional[1] : "";
+	if (output.empty()) {
+		cerr << "Usage: make_cache <input> <output>" << endl;
+		return 1;
+	}
+
+	const Instance instance = load_instance(options);
+	const string bytes = encode_cache(instance, input_path(options));
+
+	const string temporary = output + ".tmp";
+	{
+		ofstream file(temporary, ios::binary);
+		file.write(bytes.data(), bytes.size());
+		if (!file) {
+			cerr << "Could not write " << temporary << endl;
+			return 1;
+		}
+	}
+	if (rename(temporary.c_str(), output.c_str()) != 0) {
+		cerr << "Could not rename " << temporary << " to " << output << endl;
+		return 1;
+	}
+
+	cerr << "Clients: " << instance.num_clients() << ". Ingredients: " << instance.num_ingredients() << ". Conflicts: " << instance.conflict_graph().num_edges() << ". Bytes: " << bytes.size() << endl;
+
+	return 0;
+}
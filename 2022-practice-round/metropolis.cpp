@@ -1,20 +1,27 @@
 #include <algorithm>
-#include <bitset>
 #include <cmath>
+#include "conflict_graph.h"
+#include "dynamic_bitset.h"
 #include "heuristics.h"
+#include "incremental_fitness.h"
+#include "ingredient_reduction.h"
+#include "input.h"
 #include <iostream>
+#include "options.h"
 #include <random>
+#include "run_control.h"
 #include <signal.h>
-#include <unordered_map>
+#include "telemetry.h"
 #include <unordered_set>
 #include <vector>
+#include "thread_pool.h"
 
 using namespace std;
 
 constexpr int pool_size = 1000;
 double bit_flip_probability;
+constexpr double default_inverse_temperature = 6.0;
 
-bool running = true;
 bool evolution_started = false;
 
 void sigint_handler(int sig) {
@@ -34,105 +41,143 @@ struct seed {
 	seed() : dev{} {}
 };
 
-typedef bitset<10000> bits;
+typedef DynamicBitSet bits;
 
 const size_t evaluate_fitness(const bits& ingredients, const vector<bits>& client_likes, const vector<bits>& client_dislikes) {
 	size_t satisfied = 0;
 	for (size_t client = 0; client < client_likes.size(); ++client) {
-		if ((ingredients & client_likes[client]) == client_likes[client]) {
-			if ((ingredients & client_dislikes[client]).none()) {
-				++satisfied;
-			}
+		if (client_likes[client].is_subset_of(ingredients) && !client_dislikes[client].intersects(ingredients)) {
+			++satisfied;
 		}
 	}
 	return satisfied;
 }
 
 template <class Generator>
-const bits flip_random_bits(Generator& generator, const bits current_bits, const size_t num_ingredients) {
-	bits new_bits(current_bits);
-	bernoulli_distribution dist(bit_flip_probability);
-	for (size_t i = 0; i < num_ingredients; ++i) {
-		if (dist(generator)) new_bits.flip(i);
+void flip_random_bits(Generator& generator, IncrementalFitness& fitness, const size_t num_ingredients) {
+	geometric_distribution<size_t> skip(bit_flip_probability);
+	for (size_t i = skip(generator); i < num_ingredients; i += 1 + skip(generator)) {
+		fitness.flip(i);
 	}
-	return new_bits;
 }
 
-const bits ingredients_from_client_set(const unordered_set<size_t>& clients, const vector<bits>& client_likes) {
-	bits ingredients;
-	for (size_t client: clients) {
+const bits ingredients_from_client_set(const unordered_set<int>& clients, const vector<bits>& client_likes, const size_t num_ingredients) {
+	bits ingredients(num_ingredients);
+	for (int client: clients) {
 		ingredients |= client_likes[client];
 	}
 	return ingredients;
 }
 
-int main() {
+const bits ingredients_from_ids(const vector<int>& ingredients, const size_t num_ingredients) {
+	bits result(num_ingredients);
+	for (int ingredient : ingredients) {
+		result.set(ingredient);
+	}
+	return result;
+}
+
+typedef struct Chain {
+	bits current;
+	size_t current_fitness;
+	bits best;
+	size_t best_fitness;
+	IncrementalFitness fitness;
+	mt19937_64 generator;
+	uniform_real_distribution<double> real_dist;
+	uint64_t steps;
+	uint64_t accepted;
+
+	Chain(const Preferences& preferences, const bits& start, size_t start_fitness, uint64_t seed) :
+		current(start), current_fitness(start_fitness), best(start), best_fitness(start_fitness), fitness(preferences), generator(seed), real_dist(0, 1), steps(0), accepted(0) {
+		fitness.reset(current);
+	}
+
+	void step(const double inverse_temperature, const size_t num_ingredients) {
+		flip_random_bits(generator, fitness, num_ingredients);
+		++steps;
+		const size_t candidate_fitness = fitness.fitness();
+		bool accept = false;
+		if ((current_fitness == 0) || (candidate_fitness > current_fitness)) {
+			accept = true;
+		}
+		else {
+			double acceptance_ratio = exp(inverse_temperature * ((double)candidate_fitness - (double)current_fitness));
+			accept = real_dist(generator) < acceptance_ratio;
+		}
+		if (accept) {
+			++accepted;
+			current_fitness = candidate_fitness;
+			for (int ingredient : fitness.changes()) current.flip(ingredient);
+			fitness.commit();
+			if (current_fitness > best_fitness) {
+				best_fitness = current_fitness;
+				best = current;
+			}
+		}
+		else {
+			fitness.rollback();
+		}
+	}
+} Chain;
+
+int main(int argc, char** argv) {
 
+	const Options options(argc, argv);
+	RunControl control(options);
+	telemetry.start_sampling(options);
 	struct seed seeder;
 	mt19937_64 generator(seeder);
+	if (options.has("seed")) generator.seed(options.get_int("seed", 0));
 	uniform_real_distribution<double> real_dist(0, 1);
 
-	signal(SIGINT, sigint_handler);
+	const size_t num_replicas = max(1LL, options.get_int("replicas", 1));
+	const size_t num_threads = max(1LL, options.get_int("threads", num_replicas));
+	const size_t swap_interval = max(1LL, options.get_int("swap-interval", 1000));
+	const double beta_max = options.get_double("beta-max", default_inverse_temperature);
+	const double beta_min = options.get_double("beta-min", beta_max / 2);
 
-	size_t num_clients; cin >> num_clients;
+	signal(SIGINT, sigint_handler);
 
-	unordered_map<string, size_t> ingredient_ids;
-	vector<string> ingredient_names;
-	size_t num_ingredients = 0;
+	const Instance original = load_instance(options);
+	const IngredientReduction reduction = reduce_ingredients(original);
+	const Instance& instance = reduction.instance;
+	const Preferences& preferences = instance.preferences;
+	auto text = [&](const bits& ingredients) { return solution_text(original.ingredient_names(), reduction.expand(ingredients)); };
+	const size_t num_clients = instance.num_clients();
+	const size_t num_ingredients = instance.num_ingredients();
+	cerr << "Ingredients: " << original.num_ingredients() << ". Variables: " << num_ingredients << " (" << reduction.num_fixed_on << " fixed on, " << reduction.num_fixed_off << " fixed off)" << endl;
+	if (num_ingredients == 0) {
+		cout << text(bits(0));
+		telemetry.stop();
+		return 0;
+	}
 
 	vector<bits> client_likes;
 	client_likes.reserve(num_clients);
 	vector<bits> client_dislikes;
 	client_dislikes.reserve(num_clients);
-
-	for (int client = 0; client < num_clients; ++client) {
-		int num_likes; cin >> num_likes;
-		bits current_likes;
-		for (int i = 0; i < num_likes; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = num_ingredients++;
-				ingredient_names.push_back(name);
-			}
-			current_likes[ingredient_ids[name]] = true;
-		}
+	for (size_t client = 0; client < num_clients; ++client) {
+		bits current_likes(num_ingredients);
+		for (int ingredient : preferences.likes(client)) current_likes.set(ingredient);
 		client_likes.push_back(current_likes);
-
-		int num_dislikes; cin >> num_dislikes;
-		bits current_dislikes;
-		for (int i = 0; i < num_dislikes; ++i) {
-			string name; cin >> name;
-			if (ingredient_ids.count(name) == 0) {
-				ingredient_ids[name] = num_ingredients++;
-				ingredient_names.push_back(name);
-			}
-			current_dislikes[ingredient_ids[name]] = true;
-		}
+		bits current_dislikes(num_ingredients);
+		for (int ingredient : preferences.dislikes(client)) current_dislikes.set(ingredient);
 		client_dislikes.push_back(current_dislikes);
 	}
 
-	bit_flip_probability = 5/(double)num_ingredients;
-
-	vector<unordered_set<size_t>> conflict_graph;
-	conflict_graph.reserve(num_clients);
-	for (size_t i = 0; i < num_clients; ++i) conflict_graph.push_back(unordered_set<size_t>());
+	bit_flip_probability = min(0.5, 5/(double)num_ingredients);
 
-	for (size_t i = 0; i < num_clients; ++i) {
-		for (size_t j = 0; j < num_clients; ++j) {
-			if (i == j) continue;
-			if (!(client_likes[i] & client_dislikes[j]).none()) {
-				conflict_graph[i].insert(j);
-				conflict_graph[j].insert(i);
-			}
-		}
-	}
+	telemetry.enter(phase_graph);
+	const ConflictGraph& conflict_graph = instance.conflict_graph();
+	telemetry.enter(phase_seeding);
 
-	unordered_set<size_t> most_conflicting = removeMostConflicting(conflict_graph);
-	bits best_so_far = ingredients_from_client_set(most_conflicting, client_likes);
+	unordered_set<int> most_conflicting = removeMostConflictingBucketed(conflict_graph);
+	bits best_so_far = ingredients_from_client_set(most_conflicting, client_likes, num_ingredients);
 	size_t best_fitness_so_far = evaluate_fitness(best_so_far, client_likes, client_dislikes);
 
-	unordered_set<size_t> least_conflicting = addLeastConflicting(conflict_graph);
-	bits least_conflicting_ingredients = ingredients_from_client_set(least_conflicting, client_likes);
+	unordered_set<int> least_conflicting = addLeastConflictingBucketed(conflict_graph);
+	bits least_conflicting_ingredients = ingredients_from_client_set(least_conflicting, client_likes, num_ingredients);
 	const size_t least_conflicting_fitness = evaluate_fitness(least_conflicting_ingredients, client_likes, client_dislikes);
 
 	if (least_conflicting_fitness > best_fitness_so_far) {
@@ -140,48 +185,111 @@ int main() {
 		best_so_far = least_conflicting_ingredients;
 	}
 
-	bits current = best_so_far;
-	size_t current_fitness = best_fitness_so_far;
+	for (const vector<int>& solution : load_initial_solutions(options, original)) {
+		bits initial_ingredients = ingredients_from_ids(reduction.compress(solution), num_ingredients);
+		const size_t initial_fitness = evaluate_fitness(initial_ingredients, client_likes, client_dislikes);
+		cerr << "Initial solution: " << initial_fitness << endl;
+		if (initial_fitness > best_fitness_so_far) {
+			best_fitness_so_far = initial_fitness;
+			best_so_far = initial_ingredients;
+		}
+	}
 
 	size_t generation = 0;
-	size_t epoch = 0;
 	evolution_started = true;
+	telemetry.enter(phase_search);
+	telemetry.improve(best_fitness_so_far);
 
 	cerr << "Starting fitness: " << best_fitness_so_far << endl;
 
-	while (running) {
-		++generation;
-		if (generation == 1000) {
-			generation = 0;
-			++epoch;	
-			cerr << "Epoch: " << epoch << ". Best fitness: " << best_fitness_so_far << ". Current fitness: " << current_fitness << endl;
-		}
-		const bits candidate = flip_random_bits(generator, current, num_ingredients);
-		const size_t candidate_fitness = evaluate_fitness(candidate, client_likes, client_dislikes);
-		bool accept = false;
-		if ((current_fitness == 0) || (candidate_fitness > current_fitness)) {
-			accept = true;
+	if (num_replicas == 1) {
+		Chain chain(preferences, best_so_far, best_fitness_so_far, generator());
+		while (running) {
+			chain.step(beta_max, num_ingredients);
+			if (++generation == 1000) {
+				generation = 0;
+				telemetry.add(evaluations, chain.steps);
+				telemetry.add(accepted_moves, chain.accepted);
+				telemetry.improve(chain.best_fitness);
+				chain.steps = chain.accepted = 0;
+				if (control.checkpoint_due()) control.checkpoint(text(chain.best));
+				control.tick(1000);
+			}
 		}
-		else {
-			double acceptance_ratio = exp(6.0 * ((double)candidate_fitness - (double)current_fitness));
-			accept = real_dist(generator) < acceptance_ratio;
+		control.tick(generation);
+		best_so_far = chain.best;
+		best_fitness_so_far = chain.best_fitness;
+	}
+	else {
+		vector<double> inverse_temperatures;
+		vector<Chain> chains;
+		vector<size_t> chain_at;
+		chains.reserve(num_replicas);
+		for (size_t rung = 0; rung < num_replicas; ++rung) {
+			inverse_temperatures.push_back(beta_max * pow(beta_min / beta_max, rung / (double)(num_replicas - 1)));
+			chains.emplace_back(preferences, best_so_far, best_fitness_so_far, generator());
+			chain_at.push_back(rung);
 		}
-		if (accept) {
-			current_fitness = candidate_fitness;
-			current = candidate;
-			if (current_fitness > best_fitness_so_far) {
-				best_fitness_so_far = current_fitness;
-				best_so_far = current;
+
+		ThreadPool workers(min(num_threads, num_replicas));
+		size_t swap_attempts = 0;
+		size_t swaps_accepted = 0;
+		size_t parity = 0;
+		size_t pending_moves = 0;
+		while (running) {
+			workers.run([&](size_t worker) {
+				for (size_t rung = worker; rung < num_replicas; rung += workers.size()) {
+					Chain& chain = chains[chain_at[rung]];
+					for (size_t move = 0; move < swap_interval; ++move) {
+						chain.step(inverse_temperatures[rung], num_ingredients);
+					}
+				}
+			});
+
+			for (const Chain& chain : chains) {
+				if (chain.best_fitness > best_fitness_so_far) {
+					best_fitness_so_far = chain.best_fitness;
+					best_so_far = chain.best;
+				}
+			}
+
+			for (size_t rung = parity; rung + 1 < num_replicas; rung += 2) {
+				const double hotter = chains[chain_at[rung + 1]].current_fitness;
+				const double colder = chains[chain_at[rung]].current_fitness;
+				const double log_ratio = (inverse_temperatures[rung] - inverse_temperatures[rung + 1]) * (hotter - colder);
+				++swap_attempts;
+				if (log_ratio >= 0 || real_dist(generator) < exp(log_ratio)) {
+					swap(chain_at[rung], chain_at[rung + 1]);
+					++swaps_accepted;
+				}
+			}
+			parity ^= 1;
+
+			for (Chain& chain : chains) {
+				telemetry.add(evaluations, chain.steps);
+				telemetry.add(accepted_moves, chain.accepted);
+				chain.steps = chain.accepted = 0;
+			}
+			telemetry.improve(best_fitness_so_far);
+			pending_moves += num_replicas * swap_interval;
+			if (pending_moves >= 1000) {
+				if (control.checkpoint_due()) control.checkpoint(text(best_so_far));
+				control.tick(pending_moves);
+				pending_moves = 0;
 			}
 		}
+		control.tick(pending_moves);
+		cerr << "Swap rate: " << swaps_accepted / (double)max<size_t>(swap_attempts, 1) << endl;
 	}
 
 	cerr << "Writing best solution found..." << endl;
-	cout << best_so_far.count();
-	for (size_t i = 0; i < num_ingredients; ++i) {
-		if (best_so_far[i]) cout << " " << ingredient_names[i];
-	}
-	cout << endl;
+	telemetry.improve(best_fitness_so_far);
+	telemetry.enter(phase_output);
+	control.report();
+	const string solution = text(best_so_far);
+	control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Accepts "--name value", "--name=value" and bare "--flag" arguments. Anything
+// else is kept as a positional argument.
+struct Options {
+	std::unordered_map<std::string, std::vector<std::string>> values;
+	std::vector<std::string> positional;
+
+	Options(int argc, char** argv) {
+		for (int i = 1; i < argc; ++i) {
+			std::string argument = argv[i];
+			if (argument.rfind("--", 0) != 0) {
+				positional.push_back(argument);
+				continue;
+			}
+			argument = argument.substr(2);
+			const size_t equals = argument.find('=');
+			if (equals != std::string::npos) {
+				values[argument.substr(0, equals)].push_back(argument.substr(equals + 1));
+			}
+			else if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+				values[argument].push_back(argv[++i]);
+			}
+			else {
+				values[argument].push_back("");
+			}
+		}
+	}
+
+	bool has(const std::string& name) const { return values.count(name) != 0; }
+
+	std::string get(const std::string& name, const std::string& fallback = "") const {
+		auto it = values.find(name);
+		return it == values.end() ? fallback : it->second.back();
+	}
+
+	long long get_int(const std::string& name, long long fallback) const {
+		return has(name) ? std::stoll(get(name)) : fallback;
+	}
+
+	double get_double(const std::string& name, double fallback) const {
+		return has(name) ? std::stod(get(name)) : fallback;
+	}
+
+	std::vector<std::string> get_all(const std::string& name) const {
+		auto it = values.find(name);
+		return it == values.end() ? std::vector<std::string>() : it->second;
+	}
+};
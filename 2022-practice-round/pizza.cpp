@@ -1,87 +1,71 @@
+#include "conflict_graph.h"
 #include "heuristics.h"
+#include "input.h"
 #include <iostream>
+#include "options.h"
 #include <random>
-#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 using namespace std;
 
-void printIngredients(string label, const unordered_set<int>& clients, const vector<unordered_set<string>>& clientLikes) {
+void printIngredients(string label, const unordered_set<int>& clients, const Instance& instance) {
 	cerr << label << ": " << clients.size() << endl;
-	unordered_set<string> ingredients;
+	vector<char> ingredients(instance.num_ingredients(), 0);
+	size_t numIngredients = 0;
 	for (auto person : clients) {
-		for (auto ingredient : clientLikes[person]) {
-			ingredients.insert(ingredient);
+		for (auto ingredient : instance.preferences.likes(person)) {
+			if (!ingredients[ingredient]) numIngredients++;
+			ingredients[ingredient] = 1;
 		}
 	}
-	cout << ingredients.size();
-	for (auto ingredient : ingredients) {
-		cout << " " << ingredient;
+	cout << numIngredients;
+	for (size_t ingredient = 0; ingredient < ingredients.size(); ++ingredient) {
+		if (ingredients[ingredient]) cout << " " << instance.ingredient_names()[ingredient];
 	}
 	cout << endl;
 }
 
-int main() {
+int main(int argc, char** argv) {
 
-	int C; cin >> C;
+	const Options options(argc, argv);
+	const Instance instance = load_instance(options);
+	const int C = instance.num_clients();
 
-	vector<unordered_set<string>> clientLikes;
-	vector<unordered_set<string>> clientDislikes;
+	vector<IdRange> clientLikes;
+	vector<IdRange> clientDislikes;
 	clientLikes.reserve(C);
 	clientDislikes.reserve(C);
 	for (int i = 0; i < C; ++i) {
-		clientLikes.push_back(unordered_set<string>());
-		clientDislikes.push_back(unordered_set<string>());
+		clientLikes.push_back(instance.preferences.likes(i));
+		clientDislikes.push_back(instance.preferences.dislikes(i));
 	}
 
-	for (int client = 0; client < C; ++client) {
-		int L; cin >> L;
-		for (int i = 0; i < L; ++i) {
-			string ingredient; cin >> ingredient;
-			clientLikes[client].insert(ingredient);
-		}
-		int D; cin >> D;
-		for (int i = 0; i < D; ++i) {
-			string ingredient; cin >> ingredient;
-			clientDislikes[client].insert(ingredient);
-		}
-	}
-
-	vector<unordered_set<int>> conflictGraph;
-	conflictGraph.reserve(C);
-	for (int i = 0; i < C; ++i) conflictGraph.push_back(unordered_set<int>());
-
-	for (int i = 0; i < C; ++i) {
-		for (int j = 0; j < C; ++j) {
-			if (i == j) continue;
-			for (auto ingredient : clientLikes[i]) {
-				if (clientDislikes[j].count(ingredient) != 0) {
-					conflictGraph[i].insert(j);
-					conflictGraph[j].insert(i);
-					break;
-				}
-			}
-		}
-	}
+	const ConflictGraph& conflictGraph = instance.conflict_graph();
 
 	unordered_set<int> mostConflictingHeuristic = removeMostConflicting(conflictGraph);
-	printIngredients("Most Conflicting Heuristic", mostConflictingHeuristic, clientLikes);
+	printIngredients("Most Conflicting Heuristic", mostConflictingHeuristic, instance);
 
 	unordered_set<int> leastConflictingHeuristic = addLeastConflicting(conflictGraph);
-	printIngredients("Least Conflicting Heuristic", leastConflictingHeuristic, clientLikes);
+	printIngredients("Least Conflicting Heuristic", leastConflictingHeuristic, instance);
+
+	unordered_set<int> mostConflictingBucketedHeuristic = removeMostConflictingBucketed(conflictGraph);
+	printIngredients("Most Conflicting Heuristic (Bucketed)", mostConflictingBucketedHeuristic, instance);
+
+	unordered_set<int> leastConflictingBucketedHeuristic = addLeastConflictingBucketed(conflictGraph);
+	printIngredients("Least Conflicting Heuristic (Bucketed)", leastConflictingBucketedHeuristic, instance);
 
 	unordered_set<int> randomResolutionHeuristic = randomResolution(conflictGraph);
-	printIngredients("Random Resolution Heuristic", randomResolutionHeuristic, clientLikes);
+	printIngredients("Random Resolution Heuristic", randomResolutionHeuristic, instance);
 
 	unordered_set<int> uniformRandomResolutionHeuristic = uniformRandomResolution(conflictGraph);
-	printIngredients("Uniform Random Resolution Heuristic", uniformRandomResolutionHeuristic, clientLikes);
+	printIngredients("Uniform Random Resolution Heuristic", uniformRandomResolutionHeuristic, instance);
 
 	unordered_set<int> leastDislikesHeuristic = leastDislikes(conflictGraph, clientDislikes);
-	printIngredients("Least Dislikes Heuristic", leastDislikesHeuristic, clientLikes);
+	printIngredients("Least Dislikes Heuristic", leastDislikesHeuristic, instance);
 
 	unordered_set<int> fewestPreferencesHeuristic = fewestPreferences(conflictGraph, clientLikes, clientDislikes);
-	printIngredients("Fewest Preferences Heuristic", fewestPreferencesHeuristic, clientLikes);
+	printIngredients("Fewest Preferences Heuristic", fewestPreferencesHeuristic, instance);
 
 	return 0;
 }
\ No newline at end of file
@@ -1,219 +1,366 @@
 #include <algorithm>
-#include <condition_variable>
+#include <atomic>
+#include "conflict_graph.h"
+#include "heuristics.h"
+#include "independent_set.h"
+#include "input.h"
 #include <iostream>
 #include <mutex>
-#include <set>
+#include "options.h"
+#include "run_control.h"
 #include <signal.h>
-#include <stack>
+#include "telemetry.h"
 #include <thread>
 #include <unordered_set>
 #include <vector>
+#include "work_stealing.h"
 
 using namespace std;
 
-void spawn_thread(int, vector<int>, unordered_set<int>);
-
-bool running = true;
-
 void sigint_handler(int sig) {
 	cerr << "Writing best solution found so far..." << endl;
 	running = false;
 }
 
-int running_threads = 0;
-constexpr int max_threads = 8;
-
 vector<int> best_so_far;
 mutex best_lock;
+atomic<int> best_so_far_size(0);
 
-mutex thread_lock;
-condition_variable thread_check;
+ConflictGraph graph;
+const Instance* instance;
+RunControl* control;
 
-mutex thread_count_lock;
+int best_size() {
+	return best_so_far_size.load(memory_order_relaxed);
+}
 
-vector<set<int>> graph;
+void offer_solution(const vector<int>& included) {
+	const int size = included.size();
+	int current = best_size();
+	while (size > current) {
+		if (best_so_far_size.compare_exchange_weak(current, size, memory_order_relaxed)) {
+			best_lock.lock();
+			if (size > (int)best_so_far.size()) best_so_far = included;
+			best_lock.unlock();
+			telemetry.add(bound_hits);
+			telemetry.improve(size);
+			return;
+		}
+	}
+}
 
-bool can_spwan_thread() {
-	thread_count_lock.lock();
-	bool can_spawn = running_threads < max_threads;
-	thread_count_lock.unlock();
-	return can_spawn;
+string best_solution_text() {
+	lock_guard<mutex> locker(best_lock);
+	return solution_text(instance->ingredient_names(), instance->preferences.liked_ingredients(best_so_far));
 }
 
-int best_size() {
-	best_lock.lock();
-	int value = best_so_far.size();
-	best_lock.unlock();
-	return value;
+// Nodes are counted in batches so that workers do not all hit the shared
+// counters on every node.
+void count_nodes(size_t worker, uint64_t nodes, uint64_t pruned) {
+	if (control->checkpoint_due()) control->checkpoint(best_solution_text());
+	telemetry.add(nodes_expanded, nodes, worker);
+	telemetry.add(nodes_pruned, pruned, worker);
+	control->tick(nodes);
 }
 
 typedef struct StackFrame {
 	int person;
 	vector<int> included;
 	unordered_set<int> conflicts;
-	StackFrame(int _person, vector<int> _included, unordered_set<int> _conflicts): person(_person), included(_included), conflicts(_conflicts) {}
+	StackFrame(int _person, vector<int> _included, unordered_set<int> _conflicts): person(_person), included(std::move(_included)), conflicts(std::move(_conflicts)) {}
 } StackFrame;
 
-unordered_set<int> removeMostConflicting(vector<set<int> > graph) {
-	unordered_set<int> satisfied;
-	for (int i = 0; i < graph.size(); ++i) satisfied.insert(i);
-	while (true) {
-		int maxConflicts = 0;
-		int mostConflictingPerson = -1;
-		for (auto person : satisfied) {
-			int numConflicts = graph[person].size();
-			if (numConflicts > maxConflicts) {
-				maxConflicts = numConflicts;
-				mostConflictingPerson = person;
-			}
-		}
-		if (maxConflicts == 0) break;
-		satisfied.erase(mostConflictingPerson);
-		for (auto& node : graph) node.erase(mostConflictingPerson);
-	}
-	return satisfied;
-}
+// Per-worker counts not yet passed to count_nodes.
+typedef struct alignas(64) NodeCounts {
+	uint64_t nodes = 0;
+	uint64_t pruned = 0;
 
-void branch_and_bound(stack<StackFrame> call_stack) {
-	while (running && call_stack.size() > 0) {
-		StackFrame frame = call_stack.top();
-		call_stack.pop();
+	void flush(size_t worker) {
+		count_nodes(worker, nodes, pruned);
+		nodes = pruned = 0;
+	}
+} NodeCounts;
 
-		const int person = frame.person;
-		const int bound = frame.included.size() + graph.size() - person - frame.conflicts.size() + frame.conflicts.count(person);
-		if (bound <= best_size()) continue;
+void branch_and_bound(WorkStealingScheduler<StackFrame>& scheduler, size_t worker, NodeCounts& counts, StackFrame& frame) {
+	const int person = frame.person;
+	const int bound = frame.included.size() + graph.size() - person - frame.conflicts.size() + frame.conflicts.count(person);
+	const bool pruned = bound <= best_size();
+	counts.pruned += pruned;
+	if (++counts.nodes == 1024) counts.flush(worker);
+	if (pruned) return;
 
-		best_lock.lock();
-		if (frame.included.size() > best_so_far.size()) {
-			best_so_far = frame.included;
-			cerr << "Best so far: " << best_so_far.size() << endl;
-		}
-		best_lock.unlock();
+	offer_solution(frame.included);
 
-		if (person == graph.size()) {
-			continue;
-		}
+	if (person == (int)graph.size()) {
+		return;
+	}
 
-		const bool has_current_person = frame.conflicts.count(person) != 0;
-		frame.conflicts.erase(person);
+	const bool has_current_person = frame.conflicts.count(person) != 0;
+	frame.conflicts.erase(person);
 
-		const int left_bound = frame.included.size() + graph.size() - person - 1 - frame.conflicts.size();
-		if (left_bound > best_size()) {
-			if (can_spwan_thread()) {
-				spawn_thread(person + 1, frame.included, frame.conflicts);
-			}
-			else {
-				call_stack.push(StackFrame(person + 1, frame.included, frame.conflicts));
-			}
-		}
+	const int left_bound = frame.included.size() + graph.size() - person - 1 - frame.conflicts.size();
+	if (left_bound > best_size()) {
+		scheduler.push(worker, new StackFrame(person + 1, frame.included, frame.conflicts));
+	}
+	else {
+		++counts.pruned;
+	}
 
-		if (has_current_person) continue;
-		frame.included.push_back(person);
-		for (auto it = graph[person].upper_bound(person); it != graph[person].end(); ++it) {
-			frame.conflicts.insert(*it);
-		}
+	if (has_current_person) return;
+	frame.included.push_back(person);
+	const IdRange neighbours = graph[person];
+	for (auto it = upper_bound(neighbours.begin(), neighbours.end(), person); it != neighbours.end(); ++it) {
+		frame.conflicts.insert(*it);
+	}
 
-		const int right_bound = frame.included.size() + graph.size() - person - 1 - frame.conflicts.size();
-		if (right_bound > best_size()) {
-			if (can_spwan_thread()) {
-				spawn_thread(person + 1, frame.included, frame.conflicts);
-			}
-			else {
-				call_stack.push(StackFrame(person + 1, frame.included, frame.conflicts));
-			}
-		}
+	const int right_bound = frame.included.size() + graph.size() - person - 1 - frame.conflicts.size();
+	if (right_bound > best_size()) {
+		scheduler.push(worker, new StackFrame(person + 1, std::move(frame.included), std::move(frame.conflicts)));
 	}
-	
-	thread_count_lock.lock();
-	running_threads--;
-	if (running_threads == 0) {
-		thread_check.notify_all();
+	else {
+		++counts.pruned;
 	}
-	thread_count_lock.unlock();
 }
 
-void spawn_thread(int person, vector<int> included, unordered_set<int> conflicts) {
-	thread_count_lock.lock();
-	stack<StackFrame> thread_stack;
-	thread_stack.push(StackFrame(person, included, conflicts));
-	thread new_thread(branch_and_bound, thread_stack);
-	running_threads++;
-	new_thread.detach();
-	thread_count_lock.unlock();
-}
+typedef struct Subproblem {
+	int person;
+	vector<int> included;
+	Subproblem(int _person, vector<int> _included): person(_person), included(std::move(_included)) {}
+} Subproblem;
 
-int main() {
+typedef struct TrailFrame {
+	int person;
+	int stage;
+	bool conflicted;
+	bool published;
+	size_t trail_mark;
+	TrailFrame(int _person): person(_person), stage(0), conflicted(false), published(false), trail_mark(0) {}
+} TrailFrame;
+
+// One per worker. conflicts is a dense bitset over clients, pending_conflicts
+// counts its bits at or after the current person, and trail records the bits
+// set by each include so that backtracking only touches that client's edges.
+typedef struct TrailState {
+	vector<uint64_t> conflicts;
+	int pending_conflicts;
+	vector<int> included;
+	vector<int> trail;
+	vector<TrailFrame> frames;
+
+	TrailState(size_t num_clients): conflicts((num_clients + 63) / 64, 0), pending_conflicts(0) {}
 
-	int C; cin >> C;
+	bool conflicted(int person) const { return (conflicts[person >> 6] >> (person & 63)) & 1; }
 
-	vector<set<string>> clientLikes;
-	vector<set<string>> clientDislikes;
-	clientLikes.reserve(C);
-	clientDislikes.reserve(C);
-	for (int i = 0; i < C; ++i) {
-		clientLikes.push_back(set<string>());
-		clientDislikes.push_back(set<string>());
+	void reset(const Subproblem& subproblem) {
+		fill(conflicts.begin(), conflicts.end(), 0);
+		included = subproblem.included;
+		trail.clear();
+		for (int person : included) {
+			const IdRange neighbours = graph[person];
+			for (auto it = upper_bound(neighbours.begin(), neighbours.end(), person); it != neighbours.end(); ++it) {
+				conflicts[*it >> 6] |= uint64_t(1) << (*it & 63);
+			}
+		}
+		pending_conflicts = 0;
+		for (size_t person = subproblem.person; person < graph.size(); ++person) pending_conflicts += conflicted(person);
 	}
 
-	for (int client = 0; client < C; ++client) {
-		int L; cin >> L;
-		for (int i = 0; i < L; ++i) {
-			string ingredient; cin >> ingredient;
-			clientLikes[client].insert(ingredient);
+	size_t include(int person) {
+		const size_t mark = trail.size();
+		included.push_back(person);
+		const IdRange neighbours = graph[person];
+		for (auto it = upper_bound(neighbours.begin(), neighbours.end(), person); it != neighbours.end(); ++it) {
+			if (conflicted(*it)) continue;
+			conflicts[*it >> 6] |= uint64_t(1) << (*it & 63);
+			trail.push_back(*it);
+			++pending_conflicts;
 		}
-		int D; cin >> D;
-		for (int i = 0; i < D; ++i) {
-			string ingredient; cin >> ingredient;
-			clientDislikes[client].insert(ingredient);
+		return mark;
+	}
+
+	void undo(size_t mark) {
+		while (trail.size() > mark) {
+			const int person = trail.back();
+			trail.pop_back();
+			conflicts[person >> 6] &= ~(uint64_t(1) << (person & 63));
+			--pending_conflicts;
 		}
+		included.pop_back();
 	}
+} TrailState;
+
+void trail_branch_and_bound(WorkStealingScheduler<Subproblem>& scheduler, size_t worker, TrailState& state, const Subproblem& subproblem) {
+	const int num_clients = graph.size();
+	state.reset(subproblem);
+	vector<TrailFrame>& frames = state.frames;
+	frames.clear();
+	frames.push_back(TrailFrame(subproblem.person));
+	uint64_t nodes = 0;
+	uint64_t pruned = 0;
+
+	while (running && !frames.empty()) {
+		TrailFrame& frame = frames.back();
+		const int person = frame.person;
+		const int included = state.included.size();
 
-	graph.reserve(C);
-	for (int i = 0; i < C; ++i) graph.push_back(set<int>());
+		if (frame.stage == 0) {
+			if (++nodes == 1024) {
+				count_nodes(worker, nodes, pruned);
+				nodes = pruned = 0;
+			}
+			frame.conflicted = person < num_clients && state.conflicted(person);
+			const int bound = included + num_clients - person - state.pending_conflicts + frame.conflicted;
+			if (bound <= best_size()) {
+				++pruned;
+				frames.pop_back();
+				continue;
+			}
+			offer_solution(state.included);
+			if (person == num_clients) {
+				frames.pop_back();
+				continue;
+			}
+			if (frame.conflicted) --state.pending_conflicts;
+			frame.stage = 1;
+			if (frame.conflicted) continue;
+
+			if (scheduler.queued(worker) == 0 && included + num_clients - person - 1 - state.pending_conflicts > best_size()) {
+				scheduler.push(worker, new Subproblem(person + 1, state.included));
+				frame.published = true;
+			}
+			frame.trail_mark = state.include(person);
+			if (included + 1 + num_clients - person - 1 - state.pending_conflicts > best_size()) {
+				frames.push_back(TrailFrame(person + 1));
+			}
+			else {
+				++pruned;
+			}
+			continue;
+		}
 
-	for (int i = 0; i < C; ++i) {
-		for (int j = 0; j < C; ++j) {
-			if (i == j) continue;
-			for (auto ingredient : clientLikes[i]) {
-				if (clientDislikes[j].count(ingredient) != 0) {
-					graph[i].insert(j);
-					graph[j].insert(i);
-					break;
-				}
+		if (frame.stage == 1) {
+			if (!frame.conflicted) state.undo(frame.trail_mark);
+			frame.stage = 2;
+			const int left_bound = state.included.size() + num_clients - person - 1 - state.pending_conflicts;
+			if (!frame.published && left_bound > best_size()) {
+				frames.push_back(TrailFrame(person + 1));
+				continue;
 			}
+			if (!frame.published) ++pruned;
 		}
+
+		if (frame.conflicted) ++state.pending_conflicts;
+		frames.pop_back();
+	}
+	count_nodes(worker, nodes, pruned);
+}
+
+typedef struct ComponentTask {
+	size_t component;
+	ComponentTask(size_t _component): component(_component) {}
+} ComponentTask;
+
+// Reduces the conflict graph to a kernel and solves each of its components
+// exactly, the largest first. Whenever a component improves, the solutions of
+// all components are unfolded together and offered as the incumbent.
+void independent_set_search(size_t num_threads) {
+	IndependentSetKernel kernel(graph);
+	kernel.reduce();
+	const vector<vector<int>> components = kernel.components();
+	cerr << "Kernel: " << kernel.size() << " of " << graph.size() << " clients, " << components.size() << " components";
+	if (!components.empty()) cerr << ", largest " << components[0].size();
+	cerr << ". Folds: " << kernel.num_folds() << ". Taken: " << kernel.offset() << endl;
+
+	vector<vector<int>> component_solutions(components.size());
+	vector<size_t> component_bounds(components.size());
+	for (size_t i = 0; i < components.size(); ++i) component_bounds[i] = components[i].size();
+	size_t proven = 0;
+	mutex component_lock;
+	auto publish = [&]() {
+		vector<int> solution;
+		for (const vector<int>& part : component_solutions) solution.insert(solution.end(), part.begin(), part.end());
+		offer_solution(kernel.unfold(solution));
+	};
+	{
+		lock_guard<mutex> locker(component_lock);
+		publish();
 	}
 
-	unordered_set<int> heuristic = removeMostConflicting(graph);
+	WorkStealingScheduler<ComponentTask> scheduler(num_threads);
+	for (size_t i = components.size(); i-- > 0;) scheduler.push(0, new ComponentTask(i));
+	scheduler.run([&](size_t worker, ComponentTask* task) {
+		const size_t index = task->component;
+		CliqueCoverSearch search(kernel, components[index]);
+		const bool optimal = search.solve(running,
+			[&](const vector<int>& solution) {
+				lock_guard<mutex> locker(component_lock);
+				component_solutions[index] = solution;
+				publish();
+			},
+			[&](uint64_t nodes, uint64_t pruned) { count_nodes(worker, nodes, pruned); });
+		lock_guard<mutex> locker(component_lock);
+		component_bounds[index] = search.upper_bound();
+		proven += optimal;
+	}, running);
+	telemetry.add(steals, scheduler.steals());
+
+	size_t upper_bound = kernel.offset();
+	for (size_t bound : component_bounds) upper_bound += bound;
+	cerr << "Components solved: " << proven << " of " << components.size() << ". Upper bound: " << upper_bound << endl;
+}
+
+int main(int argc, char** argv) {
+
+	const Options options(argc, argv);
+	const size_t num_threads = max(1LL, options.get_int("threads", thread::hardware_concurrency()));
+
+	RunControl run_control(options);
+	control = &run_control;
+	telemetry.start_sampling(options);
+
+	const Instance loaded = load_instance(options);
+	instance = &loaded;
+	telemetry.enter(phase_graph);
+	graph = loaded.conflict_graph();
+	telemetry.enter(phase_seeding);
+
+	unordered_set<int> heuristic = removeMostConflictingBucketed(graph);
 	best_so_far = vector<int>(heuristic.begin(), heuristic.end());
+	best_so_far_size = best_so_far.size();
 	cerr << "Remove Most Conflicting Heuristic: " << best_so_far.size() << endl;
+	telemetry.improve(best_so_far.size());
+	telemetry.enter(phase_search);
 
 	signal(SIGINT, sigint_handler);
 
-	spawn_thread(0, vector<int>(), unordered_set<int>());
-	unique_lock<mutex> locker(thread_lock);
-	while (running) {
-		thread_count_lock.lock();
-		if (running_threads == 0) {
-			thread_count_lock.unlock();
-			break;
-		}
-		thread_count_lock.unlock();
-		thread_check.wait(locker);
+	if (options.has("mis")) {
+		independent_set_search(num_threads);
 	}
-
-	std::cerr << "Branch and Bound: " << best_so_far.size() << endl;
-	unordered_set<string> ingredients;
-	for (auto person : best_so_far) {
-		for (auto ingredient : clientLikes[person]) {
-			ingredients.insert(ingredient);
-		}
+	else if (options.has("trail")) {
+		WorkStealingScheduler<Subproblem> scheduler(num_threads);
+		vector<TrailState> states(scheduler.size(), TrailState(graph.size()));
+		scheduler.push(0, new Subproblem(0, vector<int>()));
+		scheduler.run([&](size_t worker, Subproblem* subproblem) { trail_branch_and_bound(scheduler, worker, states[worker], *subproblem); }, running);
+		telemetry.add(steals, scheduler.steals());
+		cerr << "Workers: " << scheduler.size() << ". Steals: " << scheduler.steals() << endl;
 	}
-	cout << ingredients.size();
-	for (auto ingredient : ingredients) {
-		cout << " " << ingredient;
+	else {
+		WorkStealingScheduler<StackFrame> scheduler(num_threads);
+		scheduler.push(0, new StackFrame(0, vector<int>(), unordered_set<int>()));
+		vector<NodeCounts> counts(scheduler.size());
+		scheduler.run([&](size_t worker, StackFrame* frame) { branch_and_bound(scheduler, worker, counts[worker], *frame); }, running);
+		for (size_t worker = 0; worker < counts.size(); ++worker) counts[worker].flush(worker);
+		telemetry.add(steals, scheduler.steals());
+		cerr << "Workers: " << scheduler.size() << ". Steals: " << scheduler.steals() << endl;
 	}
-	cout << endl;
+
+	std::cerr << "Branch and Bound: " << best_so_far.size() << endl;
+	telemetry.enter(phase_output);
+	run_control.report();
+	const string solution = best_solution_text();
+	run_control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include "conflict_graph.h"
+#include "heuristics.h"
+#include "input.h"
+#include <iostream>
+#include "options.h"
+#include <random>
+#include "run_control.h"
+#include <signal.h>
+#include "telemetry.h"
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// Iterated local search over sets of clients, after Andrade, Resende and
+// Werneck. A solution is an independent set of the conflict graph; the pizza is
+// every ingredient its clients like.
+//   --tabu-tenure N       iterations a client stays out after being forced out
+//                         by a perturbation (default 7)
+//   --restart-after N     iterations without a new best before restarting from
+//                         the best with a stronger perturbation (default 50000)
+//   --restart-strength K  clients forced in by a restart (default 8)
+
+bool search_started = false;
+
+void sigint_handler(int sig) {
+	running = false;
+	if (!search_started) exit(0);
+}
+
+struct seed {
+	typedef unsigned int result_type;
+	random_device dev;
+	template <class RandomAccessIterator>
+	void generate(RandomAccessIterator begin, RandomAccessIterator end) {
+		for (RandomAccessIterator item = begin; item != end; ++item) {
+			*item = dev();
+		}
+	}
+	seed() : dev{} {}
+};
+
+// clients is a permutation split into three blocks: the solution, the free
+// clients (no neighbour in the solution) and the rest. tight counts each
+// client's neighbours in the solution. Inserting or removing a client moves it
+// and its neighbours between blocks with swaps, so both cost O(degree).
+typedef struct Solution {
+	const ConflictGraph& graph;
+	vector<int> clients;
+	vector<int> position;
+	vector<int> tight;
+	size_t solution_size;
+	size_t free_size;
+	vector<int> newly_one_tight;
+
+	Solution(const ConflictGraph& graph) : graph(graph), clients(graph.size()), position(graph.size()), tight(graph.size(), 0), solution_size(0), free_size(graph.size()) {
+		for (size_t client = 0; client < graph.size(); ++client) clients[client] = position[client] = client;
+	}
+
+	size_t size() const { return solution_size; }
+	bool contains(int client) const { return (size_t)position[client] < solution_size; }
+	bool is_free(int client) const { return !contains(client) && tight[client] == 0; }
+
+	void move_to(int client, size_t index) {
+		const int other = clients[index];
+		swap(clients[index], clients[position[client]]);
+		position[other] = position[client];
+		position[client] = index;
+	}
+
+	void insert(int client) {
+		move_to(client, solution_size);
+		++solution_size;
+		--free_size;
+		for (int neighbour : graph[client]) {
+			if (tight[neighbour]++ == 0) {
+				move_to(neighbour, solution_size + free_size - 1);
+				--free_size;
+			}
+		}
+	}
+
+	void remove(int client) {
+		move_to(client, solution_size - 1);
+		--solution_size;
+		++free_size;
+		for (int neighbour : graph[client]) {
+			const int remaining = --tight[neighbour];
+			if (remaining == 0) {
+				move_to(neighbour, solution_size + free_size);
+				++free_size;
+			}
+			else if (remaining == 1) {
+				newly_one_tight.push_back(neighbour);
+			}
+		}
+	}
+
+	// The neighbour in the solution of a one-tight client.
+	int solution_neighbour(int client) const {
+		for (int neighbour : graph[client]) {
+			if (contains(neighbour)) return neighbour;
+		}
+		return -1;
+	}
+
+	vector<int> members() const { return vector<int>(clients.begin(), clients.begin() + solution_size); }
+} Solution;
+
+class IteratedLocalSearch {
+	const ConflictGraph& graph;
+	Solution solution;
+	mt19937_64& generator;
+	const uint64_t tabu_tenure;
+	vector<uint64_t> tabu_until;
+	vector<int> marks;
+	int mark;
+	vector<int> candidates;
+	vector<char> is_candidate;
+	vector<pair<int, bool>> log;
+	uint64_t iteration;
+
+public:
+	vector<int> best;
+	uint64_t swaps;
+
+	IteratedLocalSearch(const ConflictGraph& graph, const vector<int>& start, mt19937_64& generator, uint64_t tabu_tenure) :
+		graph(graph), solution(graph), generator(generator), tabu_tenure(tabu_tenure), tabu_until(graph.size(), 0), marks(graph.size(), 0), mark(0), is_candidate(graph.size(), 0), iteration(0), swaps(0) {
+		reset(start);
+	}
+
+	size_t size() const { return solution.size(); }
+
+	// Rebuilds the solution from scratch and makes it locally optimal.
+	void reset(const vector<int>& start) {
+		for (int client : solution.members()) solution.remove(client);
+		for (int client : start) {
+			if (solution.is_free(client)) solution.insert(client);
+		}
+		log.clear();
+		for (int client : solution.members()) add_candidate(client);
+		local_search();
+		if (solution.size() > best.size()) best = solution.members();
+	}
+
+	// Inserts count random clients, each pushing out its neighbours in the
+	// solution, then searches locally. A result worse than before is kept
+	// with probability 1 / (1 + loss * gap to the best) and otherwise undone.
+	// Returns whether the best improved.
+	bool iterate(size_t count) {
+		++iteration;
+		log.clear();
+		const size_t before = solution.size();
+		for (size_t i = 0; i < count; ++i) {
+			const size_t outside = graph.size() - solution.size();
+			if (outside == 0) break;
+			force(solution.clients[solution.size() + generator() % outside]);
+		}
+		local_search();
+		if (solution.size() > best.size()) {
+			best = solution.members();
+			return true;
+		}
+		if (solution.size() < before) {
+			const double loss = before - solution.size();
+			const double gap = best.size() - solution.size();
+			if (uniform_real_distribution<double>(0, 1)(generator) >= 1 / (1 + loss * gap)) undo();
+		}
+		return false;
+	}
+
+private:
+	void insert(int client) {
+		solution.insert(client);
+		log.emplace_back(client, true);
+	}
+
+	void remove(int client) {
+		solution.remove(client);
+		log.emplace_back(client, false);
+	}
+
+	void undo() {
+		for (auto entry = log.rbegin(); entry != log.rend(); ++entry) {
+			if (entry->second) solution.remove(entry->first);
+			else solution.insert(entry->first);
+		}
+		log.clear();
+		solution.newly_one_tight.clear();
+	}
+
+	bool tabu(int client) const { return tabu_until[client] > iteration; }
+
+	void add_candidate(int client) {
+		if (client < 0 || is_candidate[client]) return;
+		is_candidate[client] = 1;
+		candidates.push_back(client);
+	}
+
+	void force(int client) {
+		for (int neighbour : graph[client]) {
+			if (!solution.contains(neighbour)) continue;
+			remove(neighbour);
+			tabu_until[neighbour] = iteration + tabu_tenure;
+		}
+		insert(client);
+		add_candidate(client);
+	}
+
+	// Inserts every free client that is not tabu, in random order.
+	void fill() {
+		vector<int> free_clients(solution.clients.begin() + solution.size(), solution.clients.begin() + solution.size() + solution.free_size);
+		shuffle(free_clients.begin(), free_clients.end(), generator);
+		for (int client : free_clients) {
+			if (!solution.is_free(client) || tabu(client)) continue;
+			insert(client);
+			add_candidate(client);
+		}
+	}
+
+	// Replaces client with two non-adjacent neighbours whose only neighbour in
+	// the solution is client, if there are two.
+	bool two_improvement(int client) {
+		vector<int> one_tight;
+		for (int neighbour : graph[client]) {
+			if (solution.tight[neighbour] == 1 && !tabu(neighbour)) one_tight.push_back(neighbour);
+		}
+		if (one_tight.size() < 2) return false;
+		for (size_t i = 0; i + 1 < one_tight.size(); ++i) {
+			++mark;
+			for (int neighbour : graph[one_tight[i]]) marks[neighbour] = mark;
+			for (size_t j = i + 1; j < one_tight.size(); ++j) {
+				if (marks[one_tight[j]] == mark) continue;
+				remove(client);
+				insert(one_tight[i]);
+				insert(one_tight[j]);
+				add_candidate(one_tight[i]);
+				add_candidate(one_tight[j]);
+				++swaps;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// (1,2)-swaps until none applies. Only clients that were just inserted or
+	// that have a neighbour which just became one-tight are examined.
+	void local_search() {
+		fill();
+		while (true) {
+			for (int one_tight : solution.newly_one_tight) {
+				if (solution.tight[one_tight] == 1) add_candidate(solution.solution_neighbour(one_tight));
+			}
+			solution.newly_one_tight.clear();
+			if (candidates.empty()) break;
+			const int client = candidates.back();
+			candidates.pop_back();
+			is_candidate[client] = 0;
+			if (solution.contains(client) && two_improvement(client)) fill();
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+
+	const Options options(argc, argv);
+	struct seed seeder;
+	mt19937_64 generator(seeder);
+	if (options.has("seed")) generator.seed(options.get_int("seed", 0));
+	const uint64_t tabu_tenure = options.get_int("tabu-tenure", 7);
+	const uint64_t restart_after = max(1LL, options.get_int("restart-after", 50000));
+	const size_t restart_strength = max(1LL, options.get_int("restart-strength", 8));
+	RunControl control(options);
+	telemetry.start_sampling(options);
+
+	signal(SIGINT, sigint_handler);
+
+	const Instance instance = load_instance(options);
+	const Preferences& preferences = instance.preferences;
+	telemetry.enter(phase_graph);
+	const ConflictGraph& graph = instance.conflict_graph();
+	telemetry.enter(phase_seeding);
+
+	const unordered_set<int> least_conflicting = addLeastConflictingBucketed(graph);
+	vector<int> start(least_conflicting.begin(), least_conflicting.end());
+	cerr << "Least conflicting heuristic: " << start.size() << endl;
+	for (const vector<int>& solution : load_initial_solutions(options, instance)) {
+		vector<char> ingredients(instance.num_ingredients(), 0);
+		for (int ingredient : solution) ingredients[ingredient] = 1;
+		vector<int> satisfied;
+		for (size_t client = 0; client < instance.num_clients(); ++client) {
+			if (preferences.satisfied(client, ingredients)) satisfied.push_back(client);
+		}
+		cerr << "Initial solution: " << satisfied.size() << endl;
+		if (satisfied.size() > start.size()) start = satisfied;
+	}
+
+	IteratedLocalSearch search(graph, start, generator, tabu_tenure);
+	auto text = [&]() { return solution_text(instance.ingredient_names(), preferences.liked_ingredients(search.best)); };
+	cerr << "Starting size: " << search.best.size() << endl;
+
+	search_started = true;
+	telemetry.enter(phase_search);
+	telemetry.improve(search.best.size());
+
+	// Perturbations insert one client, or k + 1 with probability about
+	// 1 / (2^k * 2 * size) so that larger jumps still happen now and then.
+	uint64_t stagnant = 0;
+	uint64_t batch = 0;
+	uint64_t swaps_reported = 0;
+	while (running) {
+		size_t count = 1;
+		if (uniform_real_distribution<double>(0, 1)(generator) < 1.0 / (2 * max<size_t>(search.size(), 1))) {
+			while (count < search.size() && (generator() & 1)) ++count;
+			++count;
+		}
+		bool improved = search.iterate(count);
+		if (!improved && ++stagnant >= restart_after) {
+			stagnant = 0;
+			const vector<int> best = search.best;
+			search.reset(best);
+			improved = search.iterate(restart_strength);
+		}
+		if (improved) {
+			stagnant = 0;
+			telemetry.add(bound_hits);
+			telemetry.improve(search.best.size());
+		}
+		if (++batch == 1000) {
+			telemetry.add(evaluations, batch);
+			telemetry.add(accepted_moves, search.swaps - swaps_reported);
+			swaps_reported = search.swaps;
+			batch = 0;
+		}
+		if (control.checkpoint_due()) control.checkpoint(text());
+		control.tick();
+	}
+	telemetry.add(evaluations, batch);
+	telemetry.add(accepted_moves, search.swaps - swaps_reported);
+
+	cerr << "Iterated local search: " << search.best.size() << endl;
+	telemetry.enter(phase_output);
+	control.report();
+	const string solution = text();
+	control.checkpoint(solution);
+	cout << solution;
+	telemetry.stop();
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct IdRange {
+	const int* first;
+	const int* last;
+	const int* begin() const { return first; }
+	const int* end() const { return last; }
+	size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	int operator[](size_t index) const { return first[index]; }
+	size_t count(int id) const { return std::binary_search(first, last, id) ? 1 : 0; }
+};
+
+// Offsets and ids of a compressed sparse row array. They are either built here
+// or point into a mapped cache; storage keeps whichever it is alive, so copies
+// share it.
+struct CsrArray {
+	std::shared_ptr<const void> storage;
+	const size_t* offsets;
+	const int* ids;
+	size_t num_rows;
+
+	CsrArray() : CsrArray(std::vector<size_t>(1, 0), std::vector<int>()) {}
+
+	CsrArray(std::vector<size_t> row_offsets, std::vector<int> row_ids) {
+		auto owned = std::make_shared<std::pair<std::vector<size_t>, std::vector<int>>>(std::move(row_offsets), std::move(row_ids));
+		offsets = owned->first.data();
+		ids = owned->second.data();
+		num_rows = owned->first.size() - 1;
+		storage = std::move(owned);
+	}
+
+	CsrArray(std::shared_ptr<const void> storage, const size_t* offsets, const int* ids, size_t num_rows) : storage(std::move(storage)), offsets(offsets), ids(ids), num_rows(num_rows) {}
+
+	size_t size() const { return num_rows; }
+	size_t num_ids() const { return offsets[num_rows]; }
+	IdRange operator[](size_t row) const { return IdRange{ids + offsets[row], ids + offsets[row + 1]}; }
+};
+
+void normalise_rows(std::vector<size_t>& offsets, std::vector<int>& ids) {
+	size_t write = 0;
+	for (size_t row = 0; row + 1 < offsets.size(); ++row) {
+		const size_t start = write;
+		auto first = ids.begin() + offsets[row];
+		auto last = ids.begin() + offsets[row + 1];
+		std::sort(first, last);
+		last = std::unique(first, last);
+		write = std::copy(first, last, ids.begin() + start) - ids.begin();
+		offsets[row] = start;
+	}
+	offsets.back() = write;
+	ids.resize(write);
+}
+
+void flatten_lists(const std::vector<std::vector<int>>& lists, std::vector<size_t>& offsets, std::vector<int>& ids) {
+	offsets.assign(1, 0);
+	offsets.reserve(lists.size() + 1);
+	ids.clear();
+	for (const auto& list : lists) {
+		ids.insert(ids.end(), list.begin(), list.end());
+		offsets.push_back(ids.size());
+	}
+	normalise_rows(offsets, ids);
+}
+
+CsrArray transpose_lists(size_t num_columns, const CsrArray& lists) {
+	std::vector<size_t> transposed_offsets(num_columns + 1, 0);
+	for (size_t i = 0; i < lists.num_ids(); ++i) ++transposed_offsets[lists.ids[i] + 1];
+	for (size_t column = 0; column < num_columns; ++column) transposed_offsets[column + 1] += transposed_offsets[column];
+	std::vector<int> transposed_ids(lists.num_ids());
+	std::vector<size_t> next(transposed_offsets.begin(), transposed_offsets.end() - 1);
+	for (size_t row = 0; row < lists.size(); ++row) {
+		for (int id : lists[row]) transposed_ids[next[id]++] = row;
+	}
+	return CsrArray(std::move(transposed_offsets), std::move(transposed_ids));
+}
+
+struct Preferences {
+	size_t num_ingredients;
+	CsrArray like_lists;
+	CsrArray dislike_lists;
+	CsrArray liked_by_lists;
+	CsrArray disliked_by_lists;
+
+	Preferences(size_t num_ingredients, const std::vector<std::vector<int>>& likes, const std::vector<std::vector<int>>& dislikes) : num_ingredients(num_ingredients) {
+		std::vector<size_t> like_offsets, dislike_offsets;
+		std::vector<int> like_ids, dislike_ids;
+		flatten_lists(likes, like_offsets, like_ids);
+		flatten_lists(dislikes, dislike_offsets, dislike_ids);
+		like_lists = CsrArray(std::move(like_offsets), std::move(like_ids));
+		dislike_lists = CsrArray(std::move(dislike_offsets), std::move(dislike_ids));
+		build_index();
+	}
+
+	Preferences(size_t num_ingredients, std::vector<size_t> like_offsets, std::vector<int> like_ids, std::vector<size_t> dislike_offsets, std::vector<int> dislike_ids) : num_ingredients(num_ingredients) {
+		normalise_rows(like_offsets, like_ids);
+		normalise_rows(dislike_offsets, dislike_ids);
+		like_lists = CsrArray(std::move(like_offsets), std::move(like_ids));
+		dislike_lists = CsrArray(std::move(dislike_offsets), std::move(dislike_ids));
+		build_index();
+	}
+
+	// Lists that are already sorted and indexed, as read from a cache.
+	Preferences(size_t num_ingredients, CsrArray like_lists, CsrArray dislike_lists, CsrArray liked_by_lists, CsrArray disliked_by_lists) :
+		num_ingredients(num_ingredients),
+		like_lists(std::move(like_lists)), dislike_lists(std::move(dislike_lists)),
+		liked_by_lists(std::move(liked_by_lists)), disliked_by_lists(std::move(disliked_by_lists)) {}
+
+	size_t num_clients() const { return like_lists.size(); }
+
+	IdRange likes(size_t client) const { return like_lists[client]; }
+	IdRange dislikes(size_t client) const { return dislike_lists[client]; }
+	IdRange liked_by(size_t ingredient) const { return liked_by_lists[ingredient]; }
+	IdRange disliked_by(size_t ingredient) const { return disliked_by_lists[ingredient]; }
+
+	template <class Bits>
+	bool satisfied(size_t client, const Bits& ingredients) const {
+		for (int ingredient : likes(client)) {
+			if (!ingredients[ingredient]) return false;
+		}
+		for (int ingredient : dislikes(client)) {
+			if (ingredients[ingredient]) return false;
+		}
+		return true;
+	}
+
+	// Marks every ingredient liked by at least one of the clients.
+	template <class Clients>
+	std::vector<char> liked_ingredients(const Clients& clients) const {
+		std::vector<char> ingredients(num_ingredients, 0);
+		for (int client : clients) {
+			for (int ingredient : likes(client)) ingredients[ingredient] = 1;
+		}
+		return ingredients;
+	}
+
+private:
+	void build_index() {
+		liked_by_lists = transpose_lists(num_ingredients, like_lists);
+		disliked_by_lists = transpose_lists(num_ingredients, dislike_lists);
+	}
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "options.h"
+#include <string>
+#include <vector>
+
+// Cleared by SIGINT, by RunControl when a budget runs out, or by a search that
+// finishes on its own. Every search loop polls it.
+std::atomic<bool> running(true);
+
+// Time and iteration budgets plus periodic checkpoints, shared by the search
+// binaries:
+//   --time-limit SECONDS        stop after this much wall-clock time
+//   --max-iterations N          stop after N iterations (summed over threads)
+//   --checkpoint PATH           write the best solution here periodically
+//   --checkpoint-interval SECS  how often to write it (default 60)
+// What counts as an iteration is up to each binary. Loops with cheap
+// iterations call tick() and checkpoint_due() once per batch of about a
+// thousand, so they may run up to a batch past the limits. tick() and
+// checkpoint_due() may be called from any thread.
+class RunControl {
+	typedef std::chrono::steady_clock Clock;
+
+	const Clock::time_point start;
+	const double time_limit;
+	const uint64_t max_iterations;
+	const std::string checkpoint_path;
+	const double checkpoint_interval;
+	std::atomic<uint64_t> iterations;
+	std::atomic<int64_t> next_checkpoint;
+
+	int64_t elapsed_ms() const {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+	}
+
+public:
+	RunControl(const Options& options) :
+		start(Clock::now()),
+		time_limit(options.get_double("time-limit", 0)),
+		max_iterations(options.get_int("max-iterations", 0)),
+		checkpoint_path(options.get("checkpoint")),
+		checkpoint_interval(options.get_double("checkpoint-interval", 60)),
+		iterations(0),
+		next_checkpoint(checkpoint_interval * 1000) {}
+
+	double elapsed() const { return elapsed_ms() / 1000.0; }
+	uint64_t iteration_count() const { return iterations.load(std::memory_order_relaxed); }
+
+	void report() const {
+		std::cerr << "Iterations: " << iteration_count() << ". Elapsed: " << elapsed() << "s" << std::endl;
+	}
+
+	// Counts completed iterations and clears running once a budget is spent.
+	// Returns whether the search should go on.
+	bool tick(uint64_t count = 1) {
+		const uint64_t total = iterations.fetch_add(count, std::memory_order_relaxed) + count;
+		if (max_iterations > 0 && total >= max_iterations) running = false;
+		if (time_limit > 0 && elapsed_ms() >= time_limit * 1000) running = false;
+		return running;
+	}
+
+	// True for exactly one caller once each checkpoint interval has passed.
+	bool checkpoint_due() {
+		if (checkpoint_path.empty()) return false;
+		int64_t due = next_checkpoint.load(std::memory_order_relaxed);
+		const int64_t now = elapsed_ms();
+		if (now < due) return false;
+		return next_checkpoint.compare_exchange_strong(due, now + int64_t(checkpoint_interval * 1000), std::memory_order_relaxed);
+	}
+
+	// Writes to a temporary file and renames it over the checkpoint, so the
+	// checkpoint is always a complete solution.
+	void checkpoint(const std::string& solution) const {
+		if (checkpoint_path.empty()) return;
+		const std::string temporary = checkpoint_path + ".tmp";
+		{
+			std::ofstream file(temporary);
+			file << solution;
+			if (!file) {
+				std::cerr << "Could not write checkpoint " << temporary << std::endl;
+				return;
+			}
+		}
+		if (std::rename(temporary.c_str(), checkpoint_path.c_str()) != 0) {
+			std::cerr << "Could not rename " << temporary << " to " << checkpoint_path << std::endl;
+		}
+	}
+};
+
+// The solution in the output format: the ingredient count followed by the
+// names of the ingredients set in bits.
+template <class Bits>
+std::string solution_text(const std::vector<std::string>& ingredient_names, const Bits& bits) {
+	std::string names;
+	size_t count = 0;
+	for (size_t i = 0; i < ingredient_names.size(); ++i) {
+		if (!bits[i]) continue;
+		names += " " + ingredient_names[i];
+		++count;
+	}
+	return std::to_string(count) + names + "\n";
+}
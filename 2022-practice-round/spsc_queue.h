@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring. Slots are constructed up front
+// from a prototype and filled in place: the producer writes into
+// producer_slot() and then publish()es it, the consumer reads consumer_slot()
+// and then release()s it. Neither side allocates or blocks.
+template <class T>
+class SpscQueue {
+	std::vector<T> slots;
+	size_t mask;
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+public:
+	SpscQueue(size_t capacity, const T& prototype) : head(0), tail(0) {
+		size_t size = 1;
+		while (size < capacity) size <<= 1;
+		slots.assign(size, prototype);
+		mask = size - 1;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	T* producer_slot() {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == slots.size()) return nullptr;
+		return &slots[t & mask];
+	}
+
+	void publish() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	T* consumer_slot() {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return nullptr;
+		return &slots[h & mask];
+	}
+
+	void release() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
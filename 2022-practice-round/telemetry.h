@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include "options.h"
+#include <string>
+#include <thread>
+
+// Relaxed counters, a best-score gauge and phase timers that the searches
+// update, plus a sampling thread that writes them as JSON lines:
+//   --telemetry PATH             file to write samples to ("-" for stderr)
+//   --telemetry-interval SECS    time between samples (default 1)
+// Updating a counter is a relaxed add on the caller's shard; only the
+// sampling thread does I/O.
+
+enum Counter {
+	evaluations,      // full or incremental fitness evaluations
+	accepted_moves,   // local search moves that were kept
+	nodes_expanded,   // branch and bound / best first search nodes visited
+	nodes_pruned,     // nodes discarded because their bound could not win
+	steals,           // tasks taken from another worker's deque
+	bound_hits,       // improvements of the incumbent, i.e. of the bound
+	num_counters
+};
+
+enum Phase {
+	phase_parse,
+	phase_graph,
+	phase_seeding,
+	phase_search,
+	phase_output,
+	num_phases
+};
+
+const char* const counter_names[num_counters] = {"evaluations", "accepted_moves", "nodes_expanded", "nodes_pruned", "steals", "bound_hits"};
+const char* const phase_names[num_phases] = {"parse", "graph", "seeding", "search", "output"};
+
+class Telemetry {
+	typedef std::chrono::steady_clock Clock;
+	static constexpr size_t num_shards = 64;
+
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> counts[num_counters];
+	};
+
+	const Clock::time_point start;
+	Shard shards[num_shards];
+	std::atomic<int64_t> best;
+	std::atomic<int> phase;
+	std::atomic<int64_t> phase_started_ns;
+	std::atomic<int64_t> phase_ns[num_phases];
+
+	std::string path;
+	double interval;
+	std::thread sampler;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping;
+
+	int64_t now_ns() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	}
+
+	std::string sample(const char* event) const {
+		const int64_t elapsed = now_ns();
+		std::string line = "{\"event\": \"" + std::string(event) + "\", \"time\": " + std::to_string(elapsed / 1e9);
+		line += ", \"phase\": \"" + std::string(phase_names[phase.load(std::memory_order_relaxed)]) + "\"";
+		line += ", \"best\": " + std::to_string(best.load(std::memory_order_relaxed));
+		for (int counter = 0; counter < num_counters; ++counter) {
+			line += ", \"" + std::string(counter_names[counter]) + "\": " + std::to_string(total(Counter(counter)));
+		}
+		line += ", \"phase_seconds\": {";
+		for (int p = 0; p < num_phases; ++p) {
+			int64_t ns = phase_ns[p].load(std::memory_order_relaxed);
+			if (p == phase.load(std::memory_order_relaxed)) ns += elapsed - phase_started_ns.load(std::memory_order_relaxed);
+			line += std::string(p > 0 ? ", " : "") + "\"" + phase_names[p] + "\": " + std::to_string(ns / 1e9);
+		}
+		return line + "}}\n";
+	}
+
+	void run_sampler() {
+		std::ofstream file;
+		if (path != "-") file.open(path);
+		std::ostream& out = path == "-" ? std::cerr : file;
+		std::unique_lock<std::mutex> locker(lock);
+		while (!stopping) {
+			wake.wait_for(locker, std::chrono::duration<double>(interval));
+			out << sample(stopping ? "final" : "sample") << std::flush;
+		}
+	}
+
+public:
+	Telemetry() : start(Clock::now()), best(0), phase(phase_parse), phase_started_ns(0), interval(1), stopping(false) {
+		for (Shard& shard : shards) {
+			for (auto& count : shard.counts) count.store(0, std::memory_order_relaxed);
+		}
+		for (auto& ns : phase_ns) ns.store(0, std::memory_order_relaxed);
+	}
+
+	~Telemetry() { stop(); }
+
+	void start_sampling(const Options& options) {
+		path = options.get("telemetry");
+		interval = options.get_double("telemetry-interval", 1);
+		if (path.empty()) return;
+		sampler = std::thread(&Telemetry::run_sampler, this);
+	}
+
+	// Writes a final sample and joins the sampling thread.
+	void stop() {
+		if (!sampler.joinable()) return;
+		{
+			std::lock_guard<std::mutex> locker(lock);
+			stopping = true;
+		}
+		wake.notify_one();
+		sampler.join();
+	}
+
+	void add(Counter counter, uint64_t count = 1, size_t shard = 0) {
+		shards[shard % num_shards].counts[counter].fetch_add(count, std::memory_order_relaxed);
+	}
+
+	uint64_t total(Counter counter) const {
+		uint64_t sum = 0;
+		for (const Shard& shard : shards) sum += shard.counts[counter].load(std::memory_order_relaxed);
+		return sum;
+	}
+
+	void improve(int64_t score) {
+		int64_t current = best.load(std::memory_order_relaxed);
+		while (score > current && !best.compare_exchange_weak(current, score, std::memory_order_relaxed));
+	}
+
+	// Only the main thread changes phase.
+	void enter(Phase next) {
+		const int64_t now = now_ns();
+		const int current = phase.load(std::memory_order_relaxed);
+		phase_ns[current].fetch_add(now - phase_started_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		phase_started_ns.store(now, std::memory_order_relaxed);
+		phase.store(next, std::memory_order_relaxed);
+	}
+};
+
+Telemetry telemetry;
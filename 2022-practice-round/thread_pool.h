@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers that all run the same task once per call to run(). The
+// calling thread acts as worker 0, so a pool of size 1 never starts a thread.
+class ThreadPool {
+	std::vector<std::thread> threads;
+	std::mutex lock;
+	std::condition_variable start_condition;
+	std::condition_variable done_condition;
+	std::function<void(size_t)> task;
+	size_t generation;
+	size_t remaining;
+	bool stopping;
+
+	void work(size_t worker) {
+		size_t seen_generation = 0;
+		while (true) {
+			std::unique_lock<std::mutex> locker(lock);
+			start_condition.wait(locker, [&] { return stopping || generation != seen_generation; });
+			if (stopping) return;
+			seen_generation = generation;
+			locker.unlock();
+
+			task(worker);
+
+			locker.lock();
+			if (--remaining == 0) done_condition.notify_one();
+		}
+	}
+
+public:
+	ThreadPool(size_t num_threads) : generation(0), remaining(0), stopping(false) {
+		for (size_t worker = 1; worker < num_threads; ++worker) {
+			threads.emplace_back(&ThreadPool::work, this, worker);
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> locker(lock);
+			stopping = true;
+		}
+		start_condition.notify_all();
+		for (auto& thread : threads) thread.join();
+	}
+
+	size_t size() const { return threads.size() + 1; }
+
+	void run(const std::function<void(size_t)>& new_task) {
+		{
+			std::lock_guard<std::mutex> locker(lock);
+			task = new_task;
+			remaining = threads.size();
+			++generation;
+		}
+		start_condition.notify_all();
+		task(0);
+		std::unique_lock<std::mutex> locker(lock);
+		done_condition.wait(locker, [&] { return remaining == 0; });
+	}
+};
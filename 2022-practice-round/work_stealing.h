@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models"). Only the owning worker may push and pop; any thread may
+// steal. Retired buffers are kept alive until the deque is destroyed.
+template <class T>
+class WorkStealingDeque {
+	struct Buffer {
+		int64_t capacity;
+		std::unique_ptr<std::atomic<T*>[]> slots;
+		Buffer(int64_t capacity) : capacity(capacity), slots(new std::atomic<T*>[capacity]) {}
+		T* get(int64_t index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+		void put(int64_t index, T* item) { slots[index & (capacity - 1)].store(item, std::memory_order_relaxed); }
+	};
+
+	alignas(64) std::atomic<int64_t> top;
+	alignas(64) std::atomic<int64_t> bottom;
+	std::atomic<Buffer*> buffer;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+
+	Buffer* grow(Buffer* old, int64_t b, int64_t t) {
+		buffers.emplace_back(new Buffer(old->capacity * 2));
+		Buffer* bigger = buffers.back().get();
+		for (int64_t i = t; i < b; ++i) bigger->put(i, old->get(i));
+		buffer.store(bigger, std::memory_order_release);
+		return bigger;
+	}
+
+public:
+	WorkStealingDeque(int64_t capacity = 1024) : top(0), bottom(0) {
+		buffers.emplace_back(new Buffer(capacity));
+		buffer.store(buffers.back().get(), std::memory_order_relaxed);
+	}
+
+	void push(T* item) {
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		Buffer* current = buffer.load(std::memory_order_relaxed);
+		if (b - t > current->capacity - 1) current = grow(current, b, t);
+		current->put(b, item);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	T* pop() {
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Buffer* current = buffer.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		T* item = current->get(b);
+		if (t == b) {
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) item = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	T* steal() {
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b) return nullptr;
+		T* item = buffer.load(std::memory_order_acquire)->get(t);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+		return item;
+	}
+
+	int64_t size() const {
+		return bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+	}
+};
+
+// Fixed set of workers, each owning a deque of heap-allocated tasks. A task is
+// counted as pending from push() until process() returns for it, so the pool
+// is finished exactly when the count reaches zero.
+template <class Task>
+class WorkStealingScheduler {
+	std::vector<std::unique_ptr<WorkStealingDeque<Task>>> deques;
+	std::atomic<int64_t> pending;
+	std::atomic<uint64_t> successful_steals;
+
+	Task* steal(size_t thief, uint64_t& random_state) {
+		random_state ^= random_state << 13;
+		random_state ^= random_state >> 7;
+		random_state ^= random_state << 17;
+		const size_t start = random_state % deques.size();
+		for (size_t offset = 0; offset < deques.size(); ++offset) {
+			const size_t victim = (start + offset) % deques.size();
+			if (victim == thief) continue;
+			Task* task = deques[victim]->steal();
+			if (task != nullptr) {
+				successful_steals.fetch_add(1, std::memory_order_relaxed);
+				return task;
+			}
+		}
+		return nullptr;
+	}
+
+public:
+	WorkStealingScheduler(size_t num_workers) : pending(0), successful_steals(0) {
+		for (size_t worker = 0; worker < num_workers; ++worker) {
+			deques.emplace_back(new WorkStealingDeque<Task>());
+		}
+	}
+
+	~WorkStealingScheduler() {
+		for (auto& deque : deques) {
+			while (Task* task = deque->pop()) delete task;
+		}
+	}
+
+	size_t size() const { return deques.size(); }
+	uint64_t steals() const { return successful_steals.load(std::memory_order_relaxed); }
+	int64_t queued(size_t worker) const { return deques[worker]->size(); }
+
+	void push(size_t worker, Task* task) {
+		pending.fetch_add(1, std::memory_order_relaxed);
+		deques[worker]->push(task);
+	}
+
+	template <class Process>
+	void run(Process process, const std::atomic<bool>& running) {
+		auto work = [&](size_t worker) {
+			uint64_t random_state = 0x9e3779b97f4a7c15ULL * (worker + 1);
+			while (running.load(std::memory_order_relaxed)) {
+				Task* task = deques[worker]->pop();
+				if (task == nullptr) task = steal(worker, random_state);
+				if (task == nullptr) {
+					if (pending.load(std::memory_order_acquire) == 0) return;
+					std::this_thread::yield();
+					continue;
+				}
+				process(worker, task);
+				delete task;
+				pending.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		};
+		std::vector<std::thread> threads;
+		for (size_t worker = 1; worker < deques.size(); ++worker) threads.emplace_back(work, worker);
+		work(0);
+		for (auto& thread : threads) thread.join();
+	}
+};